@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+
+// Log-linear histogram after HdrHistogram. Values below 64 get a bucket each; above that every
+// power of two is split into 32 buckets, so any value is reported to within about 3%.
+// Fixed size and never allocates, recording is a few shifts and an increment.
+// Count is the counter type, atomic for a histogram shared between threads (see ConcurrentHistogram).
+template <typename Count>
+class BasicHistogram
+{
+	template <typename> friend class BasicHistogram;
+
+public:
+	BasicHistogram()
+	{
+		Reset();
+	}
+
+	void Record(unsigned int value)
+	{
+		counts[GetIndex(value)]++;
+		total++;
+		if (value > max)
+			max = value;
+	}
+
+	template <typename OtherCount>
+	void Merge(const BasicHistogram<OtherCount>& other)
+	{
+		for (unsigned int i = 0; i < BUCKET_COUNT; i++)
+			counts[i] += other.counts[i];
+
+		total += other.total;
+		if (other.max > max)
+			max = other.max;
+	}
+
+	void Reset()
+	{
+		for (Count& count : counts)
+			count = 0;
+
+		total = 0;
+		max = 0;
+	}
+
+	unsigned long long GetCount() const
+	{
+		return total;
+	}
+
+	unsigned int GetMax() const
+	{
+		return (unsigned int)max;
+	}
+
+	// Smallest value that at least the given percentage of recorded values are at or below
+	unsigned int GetPercentile(double percentile) const
+	{
+		if (total == 0)
+			return 0;
+
+		unsigned long long target = (unsigned long long)(percentile / 100.0 * total + 0.5);
+		if (target == 0)
+			target = 1;
+
+		unsigned long long seen = 0;
+		for (unsigned int i = 0; i < BUCKET_COUNT; i++)
+		{
+			seen += counts[i];
+			if (seen >= target)
+			{
+				unsigned int value = GetHighestValue(i);
+				return value < max ? value : (unsigned int)max;
+			}
+		}
+
+		return (unsigned int)max;
+	}
+
+private:
+	static const unsigned int SUB_BUCKET_BITS = 6;
+	static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const unsigned int HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+	static const unsigned int BUCKET_COUNT = SUB_BUCKETS + (32 - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS;
+
+	static unsigned int GetIndex(unsigned int value)
+	{
+		if (value < SUB_BUCKETS)
+			return value;
+
+		// Shift until the value lands in the upper half of the sub-buckets
+		unsigned int shift = 1;
+		while ((value >> shift) >= SUB_BUCKETS)
+			shift++;
+
+		return SUB_BUCKETS + (shift - 1) * HALF_SUB_BUCKETS + ((value >> shift) - HALF_SUB_BUCKETS);
+	}
+
+	static unsigned int GetHighestValue(unsigned int index)
+	{
+		if (index < SUB_BUCKETS)
+			return index;
+
+		unsigned int shift = (index - SUB_BUCKETS) / HALF_SUB_BUCKETS + 1;
+		unsigned long long subBucket = (index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+		return (unsigned int)(((subBucket + 1) << shift) - 1);
+	}
+
+	Count counts[BUCKET_COUNT];
+	Count total;
+	// Racing recorders may lose a new maximum to each other, which is fine for reporting
+	Count max;
+};
+
+typedef BasicHistogram<unsigned long long> Histogram;
+// Safe to record into from several threads; copy into a Histogram with Merge before reading
+typedef BasicHistogram<std::atomic<unsigned long long>> ConcurrentHistogram;
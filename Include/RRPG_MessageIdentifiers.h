@@ -1,5 +1,8 @@
 #pragma once
 #include "MessageIdentifiers.h"
+#include "RakNetTypes.h"
+#include "RakNetTime.h"
+#include "RakAssert.h"
 
 enum RRPG_ID : unsigned char
 {
@@ -8,9 +11,29 @@ enum RRPG_ID : unsigned char
 	S_BROADCAST_CHAT,
 	S_TAKE_TURN,
 	S_UPDATE_GAME_STATE,
-	S_UPDATE_PLAYER_HP,
+	// Stats that changed since the previous version, see PlayerStat
+	S_PLAYER_STATS_DELTA,
+	// Every player's stats at the current version, for clients that fell out of step
 	S_REPLY_PLAYER_STATS_REQUEST,
+	// The version the client sent is still current, followed by the request's identifier
+	S_REPLY_NOT_MODIFIED,
+	// From here on players are named by their slot in the S_GAME_STARTED roster, in both directions
+	S_PLAYER_JOB_CHOSEN,
+	S_PLAYER_ACTION_TAKEN,
+	S_TURN_CHANGED,
+	// The player in the slot let their turn run out, the server moved on without them
+	S_TURN_TIMED_OUT,
+	// The intro was accepted, carries the token that resumes the player's seat after a dropped connection
+	S_INTRO_ACCEPTED,
+	// Where the match stands, sent to a player who resumed in place of everything they missed
+	S_MATCH_SNAPSHOT,
+	// The token is unknown or its match is over, the client starts again with C_INTRO
+	S_RESUME_REJECTED,
+	// Several of the above for one recipient, each prefixed with its length in bytes as an unsigned short
+	S_BATCH,
 	C_INTRO,
+	// Sent instead of C_INTRO on a new connection to take back a seat in a match in progress
+	C_RESUME,
 	C_READY,
 	C_UNREADY,
 	C_PLAYER_LIST_REQUEST,
@@ -28,3 +51,55 @@ enum GameState : unsigned char
 	GS_GAME_OVER,
 };
 
+
+inline unsigned char GetPacketIdentifier(RakNet::Packet* packet)
+{
+	if (packet == nullptr)
+		return 255;
+
+	if ((unsigned char)packet->data[0] == ID_TIMESTAMP)
+	{
+		RakAssert(packet->length > sizeof(RakNet::MessageID) + sizeof(RakNet::Time));
+		return (unsigned char)packet->data[sizeof(RakNet::MessageID) + sizeof(RakNet::Time)];
+	}
+	else
+	{
+		return (unsigned char)packet->data[0];
+	}
+}
+
+// For logs and diagnostics, nullptr for identifiers that are not RRPG's or a disconnection
+inline const char* GetMessageName(unsigned char id)
+{
+	switch (id)
+	{
+	case ID_DISCONNECTION_NOTIFICATION: return "ID_DISCONNECTION_NOTIFICATION";
+	case ID_CONNECTION_LOST: return "ID_CONNECTION_LOST";
+	case S_GAME_STARTED: return "S_GAME_STARTED";
+	case S_REPLY_PLAYER_LIST_REQUEST: return "S_REPLY_PLAYER_LIST_REQUEST";
+	case S_BROADCAST_CHAT: return "S_BROADCAST_CHAT";
+	case S_TAKE_TURN: return "S_TAKE_TURN";
+	case S_UPDATE_GAME_STATE: return "S_UPDATE_GAME_STATE";
+	case S_PLAYER_STATS_DELTA: return "S_PLAYER_STATS_DELTA";
+	case S_REPLY_PLAYER_STATS_REQUEST: return "S_REPLY_PLAYER_STATS_REQUEST";
+	case S_REPLY_NOT_MODIFIED: return "S_REPLY_NOT_MODIFIED";
+	case S_PLAYER_JOB_CHOSEN: return "S_PLAYER_JOB_CHOSEN";
+	case S_PLAYER_ACTION_TAKEN: return "S_PLAYER_ACTION_TAKEN";
+	case S_TURN_CHANGED: return "S_TURN_CHANGED";
+	case S_TURN_TIMED_OUT: return "S_TURN_TIMED_OUT";
+	case S_INTRO_ACCEPTED: return "S_INTRO_ACCEPTED";
+	case S_MATCH_SNAPSHOT: return "S_MATCH_SNAPSHOT";
+	case S_RESUME_REJECTED: return "S_RESUME_REJECTED";
+	case S_BATCH: return "S_BATCH";
+	case C_INTRO: return "C_INTRO";
+	case C_RESUME: return "C_RESUME";
+	case C_READY: return "C_READY";
+	case C_UNREADY: return "C_UNREADY";
+	case C_PLAYER_LIST_REQUEST: return "C_PLAYER_LIST_REQUEST";
+	case C_PLAYER_STATS_REQUEST: return "C_PLAYER_STATS_REQUEST";
+	case C_CHAT: return "C_CHAT";
+	case C_JOB_CHOSEN: return "C_JOB_CHOSEN";
+	case C_ACTION_TAKEN: return "C_ACTION_TAKEN";
+	default: return nullptr;
+	}
+}
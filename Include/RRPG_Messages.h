@@ -0,0 +1,275 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_MessageIdentifiers.h"
+#include "RRPG_Serialization.h"
+
+#include "BitStream.h"
+#include "StringCompressor.h"
+#include <cstring>
+
+// The layout of every RRPG message, written down once and shared by the server and the client.
+// A message is its identifier followed by a list of fields; Write and Read are generated from that
+// list so the two sides cannot drift apart. Readers work in place on the packet's bytes and fail on
+// a wrong identifier, a short packet or a value outside its field's range.
+// Messages with a variable number of entries are a header message followed by that many Records.
+
+const int NAME_BUFFER_SIZE = 256;
+const int CHAT_BUFFER_SIZE = 2048;
+
+// A field names the type its writer takes (In) and the type its reader fills (Out)
+template <typename T>
+struct ValueField
+{
+	typedef T In;
+	typedef T& Out;
+};
+
+struct SlotField : ValueField<PlayerSlot>
+{
+	static void Write(RakNet::BitStream* bs, PlayerSlot slot) { WriteSlot(bs, slot); }
+	static bool Read(RakNet::BitStream* bs, PlayerSlot& slot) { return ReadSlot(bs, slot); }
+};
+
+struct CountField : ValueField<unsigned int>
+{
+	static void Write(RakNet::BitStream* bs, unsigned int count) { WritePlayerCount(bs, count); }
+	static bool Read(RakNet::BitStream* bs, unsigned int& count) { return ReadPlayerCount(bs, count); }
+};
+
+struct VersionField : ValueField<unsigned int>
+{
+	static void Write(RakNet::BitStream* bs, unsigned int version) { WriteVersion(bs, version); }
+	static bool Read(RakNet::BitStream* bs, unsigned int& version) { return ReadVersion(bs, version); }
+};
+
+struct JobField : ValueField<CharacterClass>
+{
+	static void Write(RakNet::BitStream* bs, CharacterClass job) { WriteJob(bs, job); }
+	static bool Read(RakNet::BitStream* bs, CharacterClass& job) { return ReadJob(bs, job); }
+};
+
+struct ActionField : ValueField<Action>
+{
+	static void Write(RakNet::BitStream* bs, Action action) { WriteAction(bs, action); }
+	static bool Read(RakNet::BitStream* bs, Action& action) { return ReadAction(bs, action); }
+};
+
+struct HealthChangeField : ValueField<int>
+{
+	static void Write(RakNet::BitStream* bs, int amount) { WriteHealthChange(bs, amount); }
+	static bool Read(RakNet::BitStream* bs, int& amount) { return ReadHealthChange(bs, amount); }
+};
+
+struct GameStateField : ValueField<GameState>
+{
+	static void Write(RakNet::BitStream* bs, GameState state) { WriteGameState(bs, state); }
+	static bool Read(RakNet::BitStream* bs, GameState& state) { return ReadGameState(bs, state); }
+};
+
+struct BoolField : ValueField<bool>
+{
+	static void Write(RakNet::BitStream* bs, bool value) { bs->Write(value); }
+	static bool Read(RakNet::BitStream* bs, bool& value) { return bs->Read(value); }
+};
+
+// Resume tokens are random, so all 64 bits go out as they are
+struct TokenField : ValueField<uint64_t>
+{
+	static void Write(RakNet::BitStream* bs, uint64_t token) { bs->Write(token); }
+	static bool Read(RakNet::BitStream* bs, uint64_t& token) { return bs->Read(token); }
+};
+
+struct ByteField : ValueField<unsigned char>
+{
+	static void Write(RakNet::BitStream* bs, unsigned char value) { bs->Write(value); }
+	static bool Read(RakNet::BitStream* bs, unsigned char& value) { return bs->Read(value); }
+};
+
+// Huffman-encoded through StringCompressor, read into the caller's buffer of Size chars
+template <int Size>
+struct CompressedStringField
+{
+	typedef const char* In;
+	typedef char* Out;
+
+	static void Write(RakNet::BitStream* bs, const char* text)
+	{
+		RakNet::StringCompressor::Instance()->EncodeString(text, Size, bs);
+	}
+
+	static bool Read(RakNet::BitStream* bs, char* text)
+	{
+		return RakNet::StringCompressor::Instance()->DecodeString(text, Size, bs);
+	}
+};
+
+typedef CompressedStringField<NAME_BUFFER_SIZE> NameField;
+typedef CompressedStringField<CHAT_BUFFER_SIZE> ChatField;
+
+// Plain bytes up to a terminating null, read as a pointer into the packet without copying
+struct TextField
+{
+	typedef const char* In;
+	typedef const char*& Out;
+
+	static void Write(RakNet::BitStream* bs, const char* text)
+	{
+		bs->WriteAlignedBytes((const unsigned char*)text, (unsigned int)strlen(text) + 1);
+	}
+
+	static bool Read(RakNet::BitStream* bs, const char*& text)
+	{
+		bs->AlignReadToByteBoundary();
+		unsigned int offset = BITS_TO_BYTES(bs->GetReadOffset());
+		unsigned int length = BITS_TO_BYTES(bs->GetNumberOfBitsUsed());
+		if (offset >= length)
+			return false;
+
+		const char* start = (const char*)bs->GetData() + offset;
+		const void* end = memchr(start, '\0', length - offset);
+		if (end == nullptr)
+			return false;
+
+		text = start;
+		bs->IgnoreBytes((unsigned int)((const char*)end - start) + 1);
+		return true;
+	}
+};
+
+// Entries of a PlayerStat mask, only the stats named by the mask are on the wire
+struct PlayerStats
+{
+	PlayerSlot slot;
+	unsigned char stats;
+	int health;
+	CharacterClass job;
+	bool dead;
+};
+
+struct PlayerStatsField
+{
+	typedef const PlayerStats& In;
+	typedef PlayerStats& Out;
+
+	static void Write(RakNet::BitStream* bs, const PlayerStats& entry)
+	{
+		WriteSlot(bs, entry.slot);
+		WriteStatMask(bs, entry.stats);
+		if (entry.stats & STAT_HEALTH)
+			WriteHealth(bs, entry.health);
+		if (entry.stats & STAT_JOB)
+			WriteJob(bs, entry.job);
+		if (entry.stats & STAT_DEAD)
+			bs->Write(entry.dead);
+	}
+
+	static bool Read(RakNet::BitStream* bs, PlayerStats& entry)
+	{
+		if (!ReadSlot(bs, entry.slot) || !ReadStatMask(bs, entry.stats))
+			return false;
+		if ((entry.stats & STAT_HEALTH) && !ReadHealth(bs, entry.health))
+			return false;
+		if ((entry.stats & STAT_JOB) && !ReadJob(bs, entry.job))
+			return false;
+		if ((entry.stats & STAT_DEAD) && !bs->Read(entry.dead))
+			return false;
+
+		return true;
+	}
+};
+
+template <typename... Fields>
+struct Record
+{
+	static void Write(RakNet::BitStream* bs, typename Fields::In... values)
+	{
+		// Braced lists are evaluated left to right, so fields go out in declaration order
+		int expand[] = { 0, (Fields::Write(bs, values), 0)... };
+		(void)expand;
+		(void)bs;
+	}
+
+	static bool Read(RakNet::BitStream* bs, typename Fields::Out... values)
+	{
+		bool ok = true;
+		int expand[] = { 0, (ok = ok && Fields::Read(bs, values), 0)... };
+		(void)expand;
+		(void)bs;
+		return ok;
+	}
+};
+
+template <RRPG_ID Id, typename... Fields>
+struct Message
+{
+	static void Write(RakNet::BitStream* bs, typename Fields::In... values)
+	{
+		bs->Write((unsigned char)Id);
+		Record<Fields...>::Write(bs, values...);
+	}
+
+	// Leaves bs after the last field, for messages followed by Records
+	static bool Read(RakNet::BitStream* bs, typename Fields::Out... values)
+	{
+		unsigned char id;
+		return bs->Read(id) && id == Id && Record<Fields...>::Read(bs, values...);
+	}
+
+	static bool Read(RakNet::Packet* p, typename Fields::Out... values)
+	{
+		RakNet::BitStream bs(p->data, p->length, false);
+		return Read(&bs, values...);
+	}
+};
+
+// Server to client
+typedef Message<S_GAME_STARTED, CountField> GameStartedMessage;
+typedef Record<NameField> RosterEntry;
+typedef Message<S_REPLY_PLAYER_LIST_REQUEST, VersionField, CountField> PlayerListMessage;
+typedef Record<NameField, BoolField> PlayerListEntry;
+typedef Message<S_BROADCAST_CHAT, TextField> ChatMessage;
+typedef Message<S_TAKE_TURN> TakeTurnMessage;
+typedef Message<S_UPDATE_GAME_STATE, GameStateField> GameStateMessage;
+// GS_GAME_OVER adds the winner
+typedef Message<S_UPDATE_GAME_STATE, GameStateField, SlotField> GameOverMessage;
+typedef Message<S_PLAYER_STATS_DELTA, VersionField, CountField> PlayerStatsDeltaMessage;
+typedef Message<S_REPLY_PLAYER_STATS_REQUEST, VersionField, CountField> PlayerStatsSnapshotMessage;
+typedef Record<PlayerStatsField> PlayerStatsEntry;
+typedef Message<S_REPLY_NOT_MODIFIED, ByteField> NotModifiedMessage;
+typedef Message<S_PLAYER_JOB_CHOSEN, SlotField, JobField> JobChosenMessage;
+// Actor, action, target, signed health change
+typedef Message<S_PLAYER_ACTION_TAKEN, SlotField, ActionField, SlotField, HealthChangeField> ActionTakenMessage;
+typedef Message<S_TURN_CHANGED, SlotField> TurnChangedMessage;
+typedef Message<S_TURN_TIMED_OUT, SlotField> TurnTimedOutMessage;
+typedef Message<S_INTRO_ACCEPTED, TokenField> IntroAcceptedMessage;
+// Game state, the resumed player's slot, whose turn it is, the stats version, then every player in slot order
+typedef Message<S_MATCH_SNAPSHOT, GameStateField, SlotField, SlotField, VersionField, CountField> MatchSnapshotMessage;
+typedef Record<NameField, PlayerStatsField> SnapshotEntry;
+typedef Message<S_RESUME_REJECTED> ResumeRejectedMessage;
+
+// Client to server
+typedef Message<C_INTRO, NameField, BoolField> IntroRequest;
+typedef Message<C_RESUME, TokenField> ResumeRequest;
+typedef Message<C_READY> ReadyRequest;
+typedef Message<C_UNREADY> UnreadyRequest;
+typedef Message<C_PLAYER_LIST_REQUEST, VersionField> PlayerListRequest;
+typedef Message<C_PLAYER_STATS_REQUEST, VersionField> PlayerStatsRequest;
+typedef Message<C_CHAT, ChatField> ChatRequest;
+typedef Message<C_JOB_CHOSEN, JobField> JobChosenRequest;
+typedef Message<C_ACTION_TAKEN, ActionField, SlotField> ActionRequest;
+
+// Handlers indexed by message identifier, unset entries are ignored
+template <typename Handler>
+struct DispatchTable
+{
+	DispatchTable()
+	{
+		for (Handler& handler : handlers)
+			handler = nullptr;
+	}
+
+	Handler handlers[256];
+
+	Handler Get(unsigned char id) const { return handlers[id]; }
+	void Set(unsigned char id, Handler handler) { handlers[id] = handler; }
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include "RakPeerInterface.h"
+#include "RakNetSocket2.h"
+#include "SignaledEvent.h"
+#include <atomic>
+#include <cassert>
+
+// Lets a packet thread sleep until RakNet has something for it instead of spinning on Receive().
+// Incoming datagrams bump a counter from RakNet's receive thread; RakNet's update thread, which
+// is what turns datagrams into packets for Receive(), signals the event once it has seen the
+// counter move. Packets RakNet raises on its own (timeouts, failed connects) are picked up when
+// the caller's wait expires.
+// RakNet's datagram handler takes no user data, so the counter is shared by the whole process and
+// only one pump may be attached at a time: one peer per process.
+class PacketPump
+{
+public:
+	PacketPump()
+		: rpi(nullptr), lastSeenDatagrams(0), pendingCycles(0)
+	{
+		event.InitEvent();
+	}
+
+	~PacketPump()
+	{
+		Detach();
+		event.CloseEvent();
+	}
+
+	void Attach(RakNet::RakPeerInterface* peer)
+	{
+		PacketPump* attached = nullptr;
+		bool isOnlyPump = AttachedPump().compare_exchange_strong(attached, this);
+		assert(isOnlyPump);
+		(void)isOnlyPump;
+		rpi = peer;
+		rpi->SetIncomingDatagramEventHandler(&PacketPump::OnIncomingDatagram);
+		rpi->SetUserUpdateThread(&PacketPump::OnUpdateCycle, this);
+	}
+
+	void Detach()
+	{
+		if (rpi == nullptr)
+			return;
+
+		rpi->SetIncomingDatagramEventHandler(nullptr);
+		rpi->SetUserUpdateThread(nullptr, nullptr);
+		rpi = nullptr;
+		AttachedPump().store(nullptr);
+	}
+
+	// Blocks until packets may be waiting or timeoutMs has passed
+	void Wait(int timeoutMs)
+	{
+		event.WaitOnEvent(timeoutMs);
+	}
+
+	// Wakes a thread blocked in Wait(), e.g. on shutdown
+	void Wake()
+	{
+		event.SetEvent();
+	}
+
+private:
+	static std::atomic<unsigned int>& DatagramCounter()
+	{
+		static std::atomic<unsigned int> counter(0);
+		return counter;
+	}
+
+	static std::atomic<PacketPump*>& AttachedPump()
+	{
+		static std::atomic<PacketPump*> pump(nullptr);
+		return pump;
+	}
+
+	static bool OnIncomingDatagram(RakNet::RNS2RecvStruct* recvStruct)
+	{
+		DatagramCounter().fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	static void OnUpdateCycle(RakNet::RakPeerInterface* peer, void* data)
+	{
+		PacketPump* pump = static_cast<PacketPump*>(data);
+		unsigned int seen = DatagramCounter().load(std::memory_order_relaxed);
+		if (seen != pump->lastSeenDatagrams)
+		{
+			pump->lastSeenDatagrams = seen;
+			// The datagram may still be sitting in RakNet's buffer this cycle, so signal the next one too
+			pump->pendingCycles = 2;
+		}
+
+		if (pump->pendingCycles > 0)
+		{
+			pump->pendingCycles--;
+			pump->event.SetEvent();
+		}
+	}
+
+private:
+	RakNet::RakPeerInterface* rpi;
+	RakNet::SignaledEvent event;
+	// Only touched from RakNet's update thread
+	unsigned int lastSeenDatagrams;
+	int pendingCycles;
+};
@@ -1,6 +1,12 @@
 #pragma once
 #include <string>
 
+// Dense per-match player index, the same on server and client
+typedef unsigned char PlayerSlot;
+const PlayerSlot NO_PLAYER_SLOT = 0xFF;
+
+const int MAX_HEALTH = 200;
+
 enum class CharacterClass : unsigned char
 {
 	Wizard,
@@ -16,6 +22,15 @@ enum class Action : unsigned char
 	AtkRng
 };
 
+// Which of a player's replicated stats an entry in a stats message carries, in write order
+enum PlayerStat : unsigned char
+{
+	STAT_HEALTH = 1 << 0,
+	STAT_JOB = 1 << 1,
+	STAT_DEAD = 1 << 2,
+	STAT_ALL = STAT_HEALTH | STAT_JOB | STAT_DEAD
+};
+
 inline const char* GetStringFromClass(CharacterClass cc)
 {
 	switch (cc)
@@ -32,7 +47,6 @@ inline const char* GetStringFromClass(CharacterClass cc)
 }
 
 
-#pragma pack(push, 1)
 struct Player
 {
 	std::string name = "";
@@ -41,4 +55,3 @@ struct Player
 	CharacterClass job;
 	bool dead = false;
 };
-#pragma pack(pop)
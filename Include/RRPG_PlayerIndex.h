@@ -0,0 +1,71 @@
+#pragma once
+#include "RRPG_Player.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Hashed lookups from a player's full 64-bit GUID or name to their slot.
+// Names are interned: the index owns the only copy and hands out a reference that stays valid
+// until the name is removed, so tables can point at it instead of keeping their own.
+class PlayerIndex
+{
+public:
+	// Returns nullptr if the name is already taken
+	const std::string* AddName(const char* name, PlayerSlot slot)
+	{
+		auto result = nameToSlot.emplace(name, slot);
+		if (!result.second)
+			return nullptr;
+
+		return &result.first->first;
+	}
+
+	bool AddGUID(uint64_t guid, PlayerSlot slot)
+	{
+		return guidToSlot.emplace(guid, slot).second;
+	}
+
+	void RemoveName(const std::string& name)
+	{
+		nameToSlot.erase(name);
+	}
+
+	void RemoveGUID(uint64_t guid)
+	{
+		guidToSlot.erase(guid);
+	}
+
+	// Repoints an existing entry after its player changed slots
+	void SetNameSlot(const std::string& name, PlayerSlot slot)
+	{
+		nameToSlot[name] = slot;
+	}
+
+	void SetGUIDSlot(uint64_t guid, PlayerSlot slot)
+	{
+		guidToSlot[guid] = slot;
+	}
+
+	PlayerSlot FindByName(const std::string& name) const
+	{
+		auto it = nameToSlot.find(name);
+		return it == nameToSlot.end() ? NO_PLAYER_SLOT : it->second;
+	}
+
+	PlayerSlot FindByGUID(uint64_t guid) const
+	{
+		auto it = guidToSlot.find(guid);
+		return it == guidToSlot.end() ? NO_PLAYER_SLOT : it->second;
+	}
+
+	void Clear()
+	{
+		nameToSlot.clear();
+		guidToSlot.clear();
+	}
+
+private:
+	std::unordered_map<std::string, PlayerSlot> nameToSlot;
+	std::unordered_map<uint64_t, PlayerSlot> guidToSlot;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "RRPG_MessageIdentifiers.h"
+
+#include "BitStream.h"
+#include "PacketPriority.h"
+#include "RakPeerInterface.h"
+
+// How each message travels, looked up from its identifier so no caller picks a priority or channel
+// by hand. Ordering only holds within a channel, so game state gets a channel of its own and nothing
+// else can hold a turn up behind it; chat is ordered on another at lower priority, so a flood of it
+// only delays more chat.
+enum SendClass : unsigned char
+{
+	// Turns, game events and stats, plus intros and resumes
+	SEND_GAME,
+	// Player list and stats requests and their replies
+	SEND_QUERY,
+	SEND_CHAT,
+	SEND_CLASS_COUNT
+};
+
+struct SendPolicy
+{
+	PacketPriority priority;
+	PacketReliability reliability;
+	char channel;
+};
+
+const SendPolicy SEND_POLICIES[SEND_CLASS_COUNT] =
+{
+	{ HIGH_PRIORITY, RELIABLE_ORDERED, 0 },
+	{ MEDIUM_PRIORITY, RELIABLE_ORDERED, 1 },
+	{ LOW_PRIORITY, RELIABLE_ORDERED, 2 },
+};
+
+inline SendClass GetSendClass(unsigned char id)
+{
+	switch (id)
+	{
+	case S_BROADCAST_CHAT:
+	case C_CHAT:
+		return SEND_CHAT;
+	case S_REPLY_PLAYER_LIST_REQUEST:
+	case S_REPLY_NOT_MODIFIED:
+	case C_PLAYER_LIST_REQUEST:
+	case C_PLAYER_STATS_REQUEST:
+		return SEND_QUERY;
+	default:
+		// A full stats reply stays ordered with the deltas that follow it
+		return SEND_GAME;
+	}
+}
+
+// For S_BATCH, whose messages all share one class
+inline uint32_t SendWithPolicy(RakNet::RakPeerInterface* rpi, const char* data, unsigned int length, SendClass sendClass,
+	const RakNet::SystemAddress& address, bool broadcast = false)
+{
+	const SendPolicy& policy = SEND_POLICIES[sendClass];
+	return rpi->Send(data, (int)length, policy.priority, policy.reliability, policy.channel, address, broadcast);
+}
+
+inline uint32_t SendWithPolicy(RakNet::RakPeerInterface* rpi, const RakNet::BitStream* bs, const RakNet::SystemAddress& address, bool broadcast = false)
+{
+	const SendPolicy& policy = SEND_POLICIES[GetSendClass(bs->GetData()[0])];
+	return rpi->Send(bs, policy.priority, policy.reliability, policy.channel, address, broadcast);
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_MessageIdentifiers.h"
+
+#include "BitStream.h"
+
+// Game fields packed to the ranges they can actually hold instead of their full C++ width.
+// Readers return false if the stream runs out or the value is not one the writer could produce.
+// Building with RRPG_FULL_WIDTH_FIELDS writes every field at its full width again, as before packing,
+// so replaying one recording with and without it measures what packing saves. Both ends must agree.
+
+template <typename T>
+inline void WriteRange(RakNet::BitStream* bs, T value, T min, T max)
+{
+#ifdef RRPG_FULL_WIDTH_FIELDS
+	bs->Write(value);
+#else
+	bs->WriteBitsFromIntegerRange(value, min, max);
+#endif
+}
+
+template <typename T>
+inline bool ReadRange(RakNet::BitStream* bs, T& value, T min, T max)
+{
+#ifdef RRPG_FULL_WIDTH_FIELDS
+	return bs->Read(value) && value >= min && value <= max;
+#else
+	return bs->ReadBitsFromIntegerRange(value, min, max) && value <= max;
+#endif
+}
+
+// 0 to MAX_HEALTH, 8 bits
+inline void WriteHealth(RakNet::BitStream* bs, int health)
+{
+	WriteRange(bs, health, 0, MAX_HEALTH);
+}
+
+inline bool ReadHealth(RakNet::BitStream* bs, int& health)
+{
+	return ReadRange(bs, health, 0, MAX_HEALTH);
+}
+
+// A signed health change, 9 bits
+inline void WriteHealthChange(RakNet::BitStream* bs, int amount)
+{
+	WriteRange(bs, amount, -MAX_HEALTH, MAX_HEALTH);
+}
+
+inline bool ReadHealthChange(RakNet::BitStream* bs, int& amount)
+{
+	return ReadRange(bs, amount, -MAX_HEALTH, MAX_HEALTH);
+}
+
+// Room for 8 classes, 3 bits
+inline void WriteJob(RakNet::BitStream* bs, CharacterClass job)
+{
+	WriteRange(bs, (unsigned char)job, (unsigned char)0, (unsigned char)7);
+}
+
+inline bool ReadJob(RakNet::BitStream* bs, CharacterClass& job)
+{
+	unsigned char value;
+	if (!ReadRange(bs, value, (unsigned char)0, (unsigned char)7) || value > (unsigned char)CharacterClass::Assassin)
+		return false;
+
+	job = (CharacterClass)value;
+	return true;
+}
+
+// 2 bits
+inline void WriteAction(RakNet::BitStream* bs, Action action)
+{
+	WriteRange(bs, (unsigned char)action, (unsigned char)0, (unsigned char)Action::AtkRng);
+}
+
+inline bool ReadAction(RakNet::BitStream* bs, Action& action)
+{
+	unsigned char value;
+	if (!ReadRange(bs, value, (unsigned char)0, (unsigned char)Action::AtkRng))
+		return false;
+
+	action = (Action)value;
+	return true;
+}
+
+// 2 bits
+inline void WriteGameState(RakNet::BitStream* bs, GameState state)
+{
+	WriteRange(bs, (unsigned char)state, (unsigned char)GS_PENDING, (unsigned char)GS_GAME_OVER);
+}
+
+inline bool ReadGameState(RakNet::BitStream* bs, GameState& state)
+{
+	unsigned char value;
+	if (!ReadRange(bs, value, (unsigned char)GS_PENDING, (unsigned char)GS_GAME_OVER))
+		return false;
+
+	state = (GameState)value;
+	return true;
+}
+
+// PlayerStat bits, 3 bits
+inline void WriteStatMask(RakNet::BitStream* bs, unsigned char stats)
+{
+	WriteRange(bs, stats, (unsigned char)0, (unsigned char)STAT_ALL);
+}
+
+inline bool ReadStatMask(RakNet::BitStream* bs, unsigned char& stats)
+{
+	return ReadRange(bs, stats, (unsigned char)0, (unsigned char)STAT_ALL);
+}
+
+// Slots and player counts both fit a byte, slots stop below NO_PLAYER_SLOT
+inline void WriteSlot(RakNet::BitStream* bs, PlayerSlot slot)
+{
+	bs->Write(slot);
+}
+
+inline bool ReadSlot(RakNet::BitStream* bs, PlayerSlot& slot)
+{
+	return bs->Read(slot) && slot != NO_PLAYER_SLOT;
+}
+
+inline void WritePlayerCount(RakNet::BitStream* bs, unsigned int count)
+{
+	RakAssert(count <= NO_PLAYER_SLOT);
+	bs->Write((unsigned char)count);
+}
+
+inline bool ReadPlayerCount(RakNet::BitStream* bs, unsigned int& count)
+{
+	unsigned char value;
+	if (!bs->Read(value))
+		return false;
+
+	count = value;
+	return true;
+}
+
+// Versions start small and grow slowly, leading zero bytes cost a bit each
+inline void WriteVersion(RakNet::BitStream* bs, unsigned int version)
+{
+#ifdef RRPG_FULL_WIDTH_FIELDS
+	bs->Write(version);
+#else
+	bs->WriteCompressed(version);
+#endif
+}
+
+inline bool ReadVersion(RakNet::BitStream* bs, unsigned int& version)
+{
+#ifdef RRPG_FULL_WIDTH_FIELDS
+	return bs->Read(version);
+#else
+	return bs->ReadCompressed(version);
+#endif
+}
@@ -0,0 +1,377 @@
+#include "bot.h"
+
+#include "BitStream.h"
+#include "MessageIdentifiers.h"
+
+const DispatchTable<Bot::MessageHandler> Bot::messageHandlers = Bot::MakeMessageHandlers();
+unsigned int Bot::DROP_PERCENT = 0;
+unsigned int Bot::CHAT_PER_SECOND = 0;
+
+void BotStats::Merge(const BotStats& other)
+{
+	turnLatency.Merge(other.turnLatency);
+	messagesSent += other.messagesSent;
+	messagesReceived += other.messagesReceived;
+	gamesFinished += other.gamesFinished;
+	turnsTimedOut += other.turnsTimedOut;
+	resumes += other.resumes;
+	resumesRejected += other.resumesRejected;
+	chatSent += other.chatSent;
+}
+
+Bot::Bot(unsigned int id, const char* serverAddress, unsigned short serverPort)
+	: rpi(RakNet::RakPeerInterface::GetInstance()), server(RakNet::UNASSIGNED_SYSTEM_ADDRESS),
+	serverAddress(serverAddress), serverPort(serverPort), name("bot" + std::to_string(id)), rng(id),
+	needsConnect(false), isConnected(false), resumeToken(0), isResuming(false), needsDrop(false), gameState(GS_PENDING), mySlot(NO_PLAYER_SLOT), awaitingTurn(false)
+{
+}
+
+Bot::~Bot()
+{
+	RakNet::RakPeerInterface::DestroyInstance(rpi);
+}
+
+bool Bot::Start()
+{
+	if (!Startup())
+		return false;
+
+	Connect();
+	return true;
+}
+
+int Bot::Update()
+{
+	if (needsConnect)
+		Connect();
+	if (CHAT_PER_SECOND > 0 && isConnected && (gameState == GS_CHARACTER_SELECT || gameState == GS_MAIN))
+		SendChat();
+
+	int handled = 0;
+	for (RakNet::Packet* p = rpi->Receive(); p != nullptr; rpi->DeallocatePacket(p), p = rpi->Receive())
+	{
+		HandlePacket(p);
+		handled++;
+	}
+
+	if (needsDrop)
+		Drop();
+
+	return handled;
+}
+
+void Bot::Stop()
+{
+	if (isConnected)
+		rpi->CloseConnection(server, true);
+
+	rpi->Shutdown(100);
+}
+
+const BotStats& Bot::GetStats() const
+{
+	return stats;
+}
+
+DispatchTable<Bot::MessageHandler> Bot::MakeMessageHandlers()
+{
+	DispatchTable<MessageHandler> table;
+	table.Set(ID_CONNECTION_REQUEST_ACCEPTED, &Bot::OnConnectionAccepted);
+	table.Set(ID_DISCONNECTION_NOTIFICATION, &Bot::OnConnectionClosed);
+	table.Set(ID_CONNECTION_LOST, &Bot::OnConnectionClosed);
+	table.Set(ID_CONNECTION_ATTEMPT_FAILED, &Bot::OnConnectionClosed);
+	table.Set(ID_NO_FREE_INCOMING_CONNECTIONS, &Bot::OnConnectionClosed);
+	table.Set(RRPG_ID::S_BATCH, &Bot::OnBatchReceived);
+	table.Set(RRPG_ID::S_GAME_STARTED, &Bot::OnGameStart);
+	table.Set(RRPG_ID::S_TAKE_TURN, &Bot::OnTakeTurn);
+	table.Set(RRPG_ID::S_UPDATE_GAME_STATE, &Bot::OnGameStateUpdate);
+	table.Set(RRPG_ID::S_PLAYER_STATS_DELTA, &Bot::OnPlayerStatsDelta);
+	table.Set(RRPG_ID::S_PLAYER_JOB_CHOSEN, &Bot::OnPlayerJobChosen);
+	table.Set(RRPG_ID::S_PLAYER_ACTION_TAKEN, &Bot::OnPlayerActionTaken);
+	table.Set(RRPG_ID::S_TURN_TIMED_OUT, &Bot::OnTurnTimedOut);
+	table.Set(RRPG_ID::S_INTRO_ACCEPTED, &Bot::OnIntroAccepted);
+	table.Set(RRPG_ID::S_MATCH_SNAPSHOT, &Bot::OnMatchSnapshot);
+	table.Set(RRPG_ID::S_RESUME_REJECTED, &Bot::OnResumeRejected);
+	return table;
+}
+
+bool Bot::Startup()
+{
+	// Any free local port
+	RakNet::SocketDescriptor socketDescriptor(0, nullptr);
+	socketDescriptor.socketFamily = AF_INET;
+	return rpi->Startup(1, &socketDescriptor, 1) == RakNet::RAKNET_STARTED;
+}
+
+void Bot::Connect()
+{
+	// Fails while the previous connection is still closing, in which case the next update retries
+	RakNet::ConnectionAttemptResult result = rpi->Connect(serverAddress.c_str(), serverPort, nullptr, 0);
+	needsConnect = result != RakNet::CONNECTION_ATTEMPT_STARTED && result != RakNet::CONNECTION_ATTEMPT_ALREADY_IN_PROGRESS;
+}
+
+void Bot::HandlePacket(RakNet::Packet* p)
+{
+	unsigned char packetIdentifier = GetPacketIdentifier(p);
+	if (packetIdentifier >= ID_USER_PACKET_ENUM && packetIdentifier != RRPG_ID::S_BATCH)
+		stats.messagesReceived++;
+
+	// Chat and the lobby's replies are counted but otherwise ignored
+	MessageHandler handler = messageHandlers.Get(packetIdentifier);
+	if (handler != nullptr)
+		(this->*handler)(p);
+}
+
+void Bot::OnConnectionAccepted(RakNet::Packet* p)
+{
+	server = p->systemAddress;
+	isConnected = true;
+	gameState = GS_PENDING;
+	mySlot = NO_PLAYER_SLOT;
+	awaitingTurn = false;
+
+	if (isResuming)
+	{
+		RakNet::BitStream resume;
+		ResumeRequest::Write(&resume, resumeToken);
+		Send(&resume);
+	}
+	else
+		SendIntro();
+}
+
+void Bot::SendChat()
+{
+	Clock::time_point now = Clock::now();
+	if (now < nextChat)
+		return;
+
+	nextChat = now + std::chrono::microseconds(1000000 / CHAT_PER_SECOND);
+	RakNet::BitStream bs;
+	ChatRequest::Write(&bs, "The quick brown fox jumps over the lazy dog while everyone else is trying to take their turn.");
+	Send(&bs);
+	stats.chatSent++;
+}
+
+void Bot::Drop()
+{
+	// No disconnection notification, the server only finds out when the new connection resumes
+	rpi->Shutdown(0);
+	RakNet::RakPeerInterface::DestroyInstance(rpi);
+	rpi = RakNet::RakPeerInterface::GetInstance();
+	needsDrop = false;
+	isConnected = false;
+	awaitingTurn = false;
+	isResuming = Startup();
+	needsConnect = isResuming;
+}
+
+void Bot::SendIntro()
+{
+	RakNet::BitStream intro;
+	IntroRequest::Write(&intro, name.c_str(), false);
+	Send(&intro);
+
+	RakNet::BitStream ready;
+	ReadyRequest::Write(&ready);
+	Send(&ready);
+}
+
+void Bot::OnConnectionClosed(RakNet::Packet* p)
+{
+	isConnected = false;
+	needsConnect = true;
+	awaitingTurn = false;
+}
+
+void Bot::OnBatchReceived(RakNet::Packet* p)
+{
+	// Same unpacking as RRPG::OnBatchReceived
+	RakNet::Packet message = *p;
+	RakNet::BitStream bs(p->data, p->length, false);
+	bs.IgnoreBits(8);
+	unsigned short length;
+	while (bs.Read(length))
+	{
+		unsigned int offset = BITS_TO_BYTES(bs.GetReadOffset());
+		if (length == 0 || offset + length > p->length || p->data[offset] == RRPG_ID::S_BATCH)
+			break;
+
+		message.data = p->data + offset;
+		message.length = length;
+		message.bitSize = BYTES_TO_BITS(length);
+		HandlePacket(&message);
+		bs.IgnoreBytes(length);
+	}
+}
+
+void Bot::OnGameStart(RakNet::Packet* p)
+{
+	unsigned int numPlayers;
+	RakNet::BitStream bs(p->data, p->length, false);
+	if (!GameStartedMessage::Read(&bs, numPlayers))
+		return;
+
+	gameState = GS_CHARACTER_SELECT;
+	mySlot = NO_PLAYER_SLOT;
+	dead.assign(numPlayers, 0);
+	char rosterName[NAME_BUFFER_SIZE];
+	for (unsigned int i = 0; i < numPlayers && RosterEntry::Read(&bs, rosterName); i++)
+		if (name == rosterName)
+			mySlot = (PlayerSlot)i;
+}
+
+void Bot::OnTakeTurn(RakNet::Packet* p)
+{
+	RakNet::BitStream bs;
+	if (gameState == GS_CHARACTER_SELECT)
+	{
+		std::uniform_int_distribution<int> job((int)CharacterClass::Wizard, (int)CharacterClass::Assassin);
+		JobChosenRequest::Write(&bs, (CharacterClass)job(rng));
+	}
+	else if (gameState == GS_MAIN)
+	{
+		std::uniform_int_distribution<int> actions((int)Action::Heal, (int)Action::AtkRng);
+		Action action = (Action)actions(rng);
+		PlayerSlot target = (action == Action::Heal || action == Action::HealRng) ? mySlot : PickTarget();
+		ActionRequest::Write(&bs, action, target);
+	}
+	else
+		return;
+
+	if (DROP_PERCENT > 0 && std::uniform_int_distribution<unsigned int>(0, 99)(rng) < DROP_PERCENT)
+	{
+		needsDrop = true;
+		return;
+	}
+
+	awaitingTurn = true;
+	turnSent = Clock::now();
+	Send(&bs);
+}
+
+void Bot::OnGameStateUpdate(RakNet::Packet* p)
+{
+	if (!GameStateMessage::Read(p, gameState) || gameState != GS_GAME_OVER)
+		return;
+
+	// Straight into the next match
+	stats.gamesFinished++;
+	awaitingTurn = false;
+	if (isConnected)
+		rpi->CloseConnection(server, true);
+	isConnected = false;
+	needsConnect = true;
+}
+
+void Bot::OnPlayerStatsDelta(RakNet::Packet* p)
+{
+	unsigned int version, count;
+	RakNet::BitStream bs(p->data, p->length, false);
+	if (!PlayerStatsDeltaMessage::Read(&bs, version, count))
+		return;
+
+	// Only deaths matter for picking targets, so missed versions are not worth a resync
+	PlayerStats entry;
+	for (unsigned int i = 0; i < count && PlayerStatsEntry::Read(&bs, entry); i++)
+		if ((entry.stats & STAT_DEAD) && entry.slot < dead.size())
+			dead[entry.slot] = entry.dead;
+}
+
+void Bot::OnPlayerJobChosen(RakNet::Packet* p)
+{
+	PlayerSlot slot;
+	CharacterClass job;
+	if (JobChosenMessage::Read(p, slot, job) && slot == mySlot)
+		OnTurnAnswered();
+}
+
+void Bot::OnPlayerActionTaken(RakNet::Packet* p)
+{
+	PlayerSlot origin, target;
+	Action action;
+	int amount;
+	if (ActionTakenMessage::Read(p, origin, action, target, amount) && origin == mySlot)
+		OnTurnAnswered();
+}
+
+void Bot::OnTurnTimedOut(RakNet::Packet* p)
+{
+	PlayerSlot slot;
+	if (!TurnTimedOutMessage::Read(p, slot) || slot != mySlot)
+		return;
+
+	// Not a turn the server answered, so it stays out of the latency figures
+	stats.turnsTimedOut++;
+	awaitingTurn = false;
+}
+
+void Bot::OnIntroAccepted(RakNet::Packet* p)
+{
+	IntroAcceptedMessage::Read(p, resumeToken);
+}
+
+void Bot::OnMatchSnapshot(RakNet::Packet* p)
+{
+	RakNet::BitStream bs(p->data, p->length, false);
+	GameState state;
+	PlayerSlot slot, turn;
+	unsigned int version, count;
+	if (!MatchSnapshotMessage::Read(&bs, state, slot, turn, version, count))
+		return;
+
+	// The server sends S_TAKE_TURN after this if the turn is ours
+	isResuming = false;
+	stats.resumes++;
+	gameState = state;
+	mySlot = slot;
+	dead.assign(count, 0);
+	char rosterName[NAME_BUFFER_SIZE];
+	PlayerStats entry;
+	for (unsigned int i = 0; i < count && SnapshotEntry::Read(&bs, rosterName, entry); i++)
+		if (entry.slot < dead.size())
+			dead[entry.slot] = entry.dead;
+}
+
+void Bot::OnResumeRejected(RakNet::Packet* p)
+{
+	// The match ended while we were away, queue for another
+	isResuming = false;
+	stats.resumesRejected++;
+	SendIntro();
+}
+
+void Bot::Send(const RakNet::BitStream* bs)
+{
+	SendWithPolicy(rpi, bs, server);
+	stats.messagesSent++;
+}
+
+void Bot::OnTurnAnswered()
+{
+	if (!awaitingTurn)
+		return;
+
+	awaitingTurn = false;
+	long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - turnSent).count();
+	stats.turnLatency.Record(elapsed > 0xFFFFFFFFll ? 0xFFFFFFFFu : (unsigned int)elapsed);
+}
+
+PlayerSlot Bot::PickTarget()
+{
+	unsigned int living = 0;
+	for (size_t slot = 0; slot < dead.size(); slot++)
+		if (!dead[slot] && slot != mySlot)
+			living++;
+
+	if (living == 0)
+		return mySlot;
+
+	std::uniform_int_distribution<unsigned int> pick(0, living - 1);
+	unsigned int chosen = pick(rng);
+	for (size_t slot = 0; slot < dead.size(); slot++)
+		if (!dead[slot] && slot != mySlot && chosen-- == 0)
+			return (PlayerSlot)slot;
+
+	return mySlot;
+}
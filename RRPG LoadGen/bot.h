@@ -0,0 +1,108 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_Messages.h"
+#include "RRPG_SendPolicy.h"
+#include "RRPG_Histogram.h"
+
+#include "RakPeerInterface.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// What one bot measured, merged across bots for the report
+struct BotStats
+{
+	// Microseconds from sending a job or action to the server broadcasting its result
+	Histogram turnLatency;
+	unsigned long long messagesSent = 0;
+	unsigned long long messagesReceived = 0;
+	unsigned long long gamesFinished = 0;
+	// Turns the server gave up waiting on, a bot answers at once so any of these point at lost packets
+	unsigned long long turnsTimedOut = 0;
+	// Dropped connections that came back to their match, and ones the server no longer had a seat for
+	unsigned long long resumes = 0;
+	unsigned long long resumesRejected = 0;
+	unsigned long long chatSent = 0;
+
+	void Merge(const BotStats& other);
+};
+
+// A scripted client speaking the same protocol as RRPG. It joins a lobby, readies up, picks a random
+// job and then takes random actions whenever it is its turn. Once a game ends it reconnects and plays
+// another. With DROP_PERCENT set it sometimes vanishes instead of taking its turn and resumes on a new
+// connection, and with CHAT_PER_SECOND set it floods its match with chat while it plays.
+// Not thread-safe; a bot is only ever updated from one thread.
+class Bot
+{
+public:
+	Bot(unsigned int id, const char* serverAddress, unsigned short serverPort);
+	~Bot();
+
+	bool Start();
+	// Handles every packet waiting for this bot, returns how many there were
+	int Update();
+	void Stop();
+
+	const BotStats& GetStats() const;
+
+	// Chance of dropping the connection on each turn, 0 never drops
+	static unsigned int DROP_PERCENT;
+	// Chat lines sent per second while in a game, 0 sends none. Turn latency with and without it
+	// shows whether chat holds game traffic up
+	static unsigned int CHAT_PER_SECOND;
+
+private:
+	typedef void (Bot::*MessageHandler)(RakNet::Packet* p);
+	static DispatchTable<MessageHandler> MakeMessageHandlers();
+	static const DispatchTable<MessageHandler> messageHandlers;
+
+	bool Startup();
+	void Connect();
+	// Goes silent like a phone losing signal, then comes back on a new peer with a new GUID
+	void Drop();
+	void SendIntro();
+	void SendChat();
+	void HandlePacket(RakNet::Packet* p);
+	void OnConnectionAccepted(RakNet::Packet* p);
+	void OnConnectionClosed(RakNet::Packet* p);
+	void OnBatchReceived(RakNet::Packet* p);
+	void OnGameStart(RakNet::Packet* p);
+	void OnTakeTurn(RakNet::Packet* p);
+	void OnGameStateUpdate(RakNet::Packet* p);
+	void OnPlayerStatsDelta(RakNet::Packet* p);
+	void OnPlayerJobChosen(RakNet::Packet* p);
+	void OnPlayerActionTaken(RakNet::Packet* p);
+	void OnTurnTimedOut(RakNet::Packet* p);
+	void OnIntroAccepted(RakNet::Packet* p);
+	void OnMatchSnapshot(RakNet::Packet* p);
+	void OnResumeRejected(RakNet::Packet* p);
+
+	void Send(const RakNet::BitStream* bs);
+	void OnTurnAnswered();
+	PlayerSlot PickTarget();
+
+	typedef std::chrono::steady_clock Clock;
+
+	RakNet::RakPeerInterface* rpi;
+	RakNet::SystemAddress server;
+	std::string serverAddress;
+	unsigned short serverPort;
+	std::string name;
+	std::mt19937 rng;
+	bool needsConnect;
+	bool isConnected;
+	uint64_t resumeToken;
+	bool isResuming;
+	// Set mid-packet, the peer is only swapped once Update is done with its packets
+	bool needsDrop;
+
+	GameState gameState;
+	PlayerSlot mySlot;
+	std::vector<unsigned char> dead;
+	bool awaitingTurn;
+	Clock::time_point turnSent;
+	Clock::time_point nextChat;
+
+	BotStats stats;
+};
@@ -0,0 +1,73 @@
+#include "loadgen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+unsigned int LoadGen::DRIVER_THREADS = 4;
+
+LoadGen::LoadGen(const char* serverAddress, unsigned short serverPort, unsigned int botCount)
+	: isStopping(false)
+{
+	for (unsigned int i = 0; i < botCount; i++)
+		bots.emplace_back(new Bot(i, serverAddress, serverPort));
+}
+
+void LoadGen::Run(unsigned int seconds)
+{
+	unsigned int threadCount = std::max(1u, std::min(DRIVER_THREADS, (unsigned int)bots.size()));
+	printf("Running %u bots on %u threads for %u seconds\n", (unsigned int)bots.size(), threadCount, seconds);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> drivers;
+	for (unsigned int i = 0; i < threadCount; i++)
+		drivers.emplace_back(&LoadGen::Drive, this, i, threadCount);
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	isStopping = true;
+	for (std::thread& driver : drivers)
+		driver.join();
+
+	PrintReport(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void LoadGen::Drive(unsigned int first, unsigned int step)
+{
+	for (unsigned int i = first; i < bots.size(); i += step)
+		if (!bots[i]->Start())
+			printf("Bot %u could not start\n", i);
+
+	while (!isStopping)
+	{
+		int handled = 0;
+		for (unsigned int i = first; i < bots.size(); i += step)
+			handled += bots[i]->Update();
+
+		if (handled == 0)
+			std::this_thread::yield();
+	}
+
+	for (unsigned int i = first; i < bots.size(); i += step)
+		bots[i]->Stop();
+}
+
+void LoadGen::PrintReport(double seconds) const
+{
+	BotStats total;
+	for (const std::unique_ptr<Bot>& bot : bots)
+		total.Merge(bot->GetStats());
+
+	const Histogram& latency = total.turnLatency;
+	printf("%llu games finished, %llu turns in %.1f seconds, %llu turns timed out\n", total.gamesFinished, latency.GetCount(), seconds, total.turnsTimedOut);
+	printf("Turn latency: p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms\n",
+		latency.GetPercentile(50.0) / 1000.0,
+		latency.GetPercentile(99.0) / 1000.0,
+		latency.GetPercentile(99.9) / 1000.0,
+		latency.GetMax() / 1000.0);
+	printf("Messages: %.0f/s sent, %.0f/s received\n", total.messagesSent / seconds, total.messagesReceived / seconds);
+	if (Bot::CHAT_PER_SECOND > 0)
+		printf("Chat flood: %.0f lines/s sent\n", total.chatSent / seconds);
+	if (Bot::DROP_PERCENT > 0)
+		printf("Dropped connections: %llu resumed, %llu rejected\n", total.resumes, total.resumesRejected);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "bot.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs many bots against one server from a single process and reports turn latency and message
+// throughput. Bots are split across driver threads that poll them without sleeping, so latency is
+// not padded by timer resolution; give it cores of its own rather than sharing the server's.
+class LoadGen
+{
+public:
+	LoadGen(const char* serverAddress, unsigned short serverPort, unsigned int botCount);
+
+	void Run(unsigned int seconds);
+
+	static unsigned int DRIVER_THREADS;
+
+private:
+	void Drive(unsigned int first, unsigned int step);
+	void PrintReport(double seconds) const;
+
+	std::vector<std::unique_ptr<Bot>> bots;
+	std::atomic<bool> isStopping;
+};
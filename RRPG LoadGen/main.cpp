@@ -0,0 +1,35 @@
+#include "loadgen.h"
+#include "playerbench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "--bench-players") == 0)
+	{
+		PlayerBench::Run(argc > 2 ? (unsigned int)atoi(argv[2]) : 10000, argc > 3 ? (unsigned int)atoi(argv[3]) : 3, argc > 4 ? (unsigned int)atoi(argv[4]) : 1000);
+		return 0;
+	}
+
+	if (argc < 3)
+	{
+		printf("Usage: rrpg_loadgen <server ip> <server port> [bots] [seconds] [threads] [drop %%] [chat/s]\n");
+		printf("       rrpg_loadgen --bench-players [players] [per match] [rounds]\n");
+		return 1;
+	}
+
+	unsigned int botCount = argc > 3 ? (unsigned int)atoi(argv[3]) : 300;
+	unsigned int seconds = argc > 4 ? (unsigned int)atoi(argv[4]) : 60;
+	if (argc > 5)
+		LoadGen::DRIVER_THREADS = (unsigned int)atoi(argv[5]);
+	if (argc > 6)
+		Bot::DROP_PERCENT = (unsigned int)atoi(argv[6]);
+	if (argc > 7)
+		Bot::CHAT_PER_SECOND = (unsigned int)atoi(argv[7]);
+
+	LoadGen loadGen(argv[1], (unsigned short)atoi(argv[2]), botCount);
+	loadGen.Run(seconds);
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include "playerbench.h"
+#include "../RRPG Server/playertable.h"
+
+#include "RakNetTypes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// The old RRPG_Player.h Player, packed as it was
+#pragma pack(push, 1)
+	struct MapPlayer
+	{
+		std::string name = "";
+		int health = 100;
+		bool ready = false;
+		CharacterClass job;
+		bool dead = false;
+	};
+#pragma pack(pop)
+
+	// Keyed by the GUID truncated to 32 bits, with addresses in a map of their own
+	struct MapMatch
+	{
+		std::map<unsigned long, MapPlayer> players;
+		std::map<unsigned long, RakNet::SystemAddress> playerAddresses;
+		unsigned long currentPlayerTurn;
+	};
+
+	struct TableMatch
+	{
+		PlayerTable players;
+		std::vector<RakNet::RakNetGUID> guids;
+		PlayerSlot currentPlayerTurn;
+	};
+
+	uint64_t GetGUID(unsigned int player)
+	{
+		// Spread over the high bits too, like real GUIDs
+		return (uint64_t)(player + 1) * 0x9E3779B97F4A7C15ull;
+	}
+
+	// Every fourth player is already dead, so turns have someone to skip
+	bool IsInitiallyDead(unsigned int player)
+	{
+		return player % 4 == 3;
+	}
+
+	unsigned long long RunMap(std::vector<MapMatch>& matches)
+	{
+		unsigned long long checksum = 0;
+		for (MapMatch& match : matches)
+		{
+			// NextTurn
+			auto it = match.players.find(match.currentPlayerTurn);
+			it++;
+			while (it == match.players.end() || it->second.dead)
+			{
+				if (it == match.players.end())
+					it = match.players.begin();
+				else
+					it++;
+			}
+			match.currentPlayerTurn = it->first;
+
+			// The sender of the next command
+			auto sender = match.players.find(match.currentPlayerTurn);
+			checksum += match.playerAddresses.find(sender->first)->second.GetPort();
+			sender->second.health = sender->second.health % MAX_HEALTH + 1;
+
+			// OnPlayerStatsRequest
+			for (const auto& player : match.players)
+				checksum += player.second.health + (int)player.second.job + player.second.dead;
+
+			// Win detection
+			checksum += std::count_if(match.players.begin(), match.players.end(), [](const std::pair<const unsigned long, MapPlayer>& p) { return !p.second.dead; });
+		}
+
+		return checksum;
+	}
+
+	unsigned long long RunTable(std::vector<std::unique_ptr<TableMatch>>& matches)
+	{
+		unsigned long long checksum = 0;
+		for (std::unique_ptr<TableMatch>& match : matches)
+		{
+			PlayerTable& players = match->players;
+			match->currentPlayerTurn = players.NextAlive(match->currentPlayerTurn);
+
+			PlayerSlot sender = players.FindByGUID(match->guids[match->currentPlayerTurn]);
+			checksum += players.GetAddress(sender).GetPort();
+			players.SetHealth(sender, players.GetHealth(sender) % MAX_HEALTH + 1);
+
+			for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+				checksum += players.GetHealth(slot) + (int)players.GetJob(slot) + players.IsDead(slot);
+
+			checksum += players.GetAliveCount();
+			players.ClearDirtyStats();
+		}
+
+		return checksum;
+	}
+
+	template <typename Function>
+	double Time(unsigned int rounds, unsigned long long& checksum, Function run)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int round = 0; round < rounds; round++)
+			checksum += run();
+
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void PlayerBench::Run(unsigned int playerCount, unsigned int playersPerMatch, unsigned int rounds)
+{
+	playersPerMatch = std::max(2u, std::min(playersPerMatch, (unsigned int)PlayerTable::MAX_PLAYERS));
+	unsigned int matchCount = std::max(1u, playerCount / playersPerMatch);
+	playerCount = matchCount * playersPerMatch;
+
+	std::vector<MapMatch> mapMatches(matchCount);
+	std::vector<std::unique_ptr<TableMatch>> tableMatches;
+	char name[16];
+	for (unsigned int m = 0; m < matchCount; m++)
+	{
+		MapMatch& mapMatch = mapMatches[m];
+		tableMatches.emplace_back(new TableMatch());
+		TableMatch& tableMatch = *tableMatches.back();
+		for (unsigned int i = 0; i < playersPerMatch; i++)
+		{
+			unsigned int player = m * playersPerMatch + i;
+			RakNet::RakNetGUID guid(GetGUID(player));
+			RakNet::SystemAddress address("127.0.0.1", (unsigned short)(1024 + player % 60000));
+			snprintf(name, sizeof(name), "bot%u", player);
+			CharacterClass job = (CharacterClass)(player % 3);
+
+			unsigned long key = RakNet::RakNetGUID::ToUint32(guid);
+			MapPlayer& mapPlayer = mapMatch.players[key];
+			mapPlayer.name = name;
+			mapPlayer.job = job;
+			mapPlayer.dead = IsInitiallyDead(player);
+			mapMatch.playerAddresses[key] = address;
+
+			PlayerSlot slot = tableMatch.players.Add(guid, address, name);
+			tableMatch.players.SetJob(slot, job);
+			tableMatch.guids.push_back(guid);
+		}
+
+		// Players only die once the game is under way, after everyone has joined
+		for (unsigned int i = 0; i < playersPerMatch; i++)
+			if (IsInitiallyDead(m * playersPerMatch + i))
+				tableMatch.players.Kill((PlayerSlot)i);
+
+		mapMatch.currentPlayerTurn = mapMatch.players.begin()->first;
+		tableMatch.currentPlayerTurn = 0;
+		tableMatch.players.ClearDirtyStats();
+	}
+
+	unsigned long long mapChecksum = 0, tableChecksum = 0;
+	// One untimed round each to warm the caches the same way
+	RunMap(mapMatches);
+	RunTable(tableMatches);
+	double mapNs = Time(rounds, mapChecksum, [&] { return RunMap(mapMatches); });
+	double tableNs = Time(rounds, tableChecksum, [&] { return RunTable(tableMatches); });
+
+	double turns = (double)matchCount * rounds;
+	printf("%u players in %u matches of %u, %u rounds\n", playerCount, matchCount, playersPerMatch, rounds);
+	printf("std::map layout: %.1f ns per turn (checksum %llu)\n", mapNs / turns, mapChecksum);
+	printf("PlayerTable:     %.1f ns per turn (checksum %llu), %.2fx\n", tableNs / turns, tableChecksum, mapNs / tableNs);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Times the per-turn player work of many small matches against the map-based layout Match used
+// before PlayerTable: advancing the turn, looking up the sender, walking stats for a stats reply and
+// checking for a winner. Runs offline, no server needed.
+class PlayerBench
+{
+public:
+	static void Run(unsigned int playerCount, unsigned int playersPerMatch, unsigned int rounds);
+};
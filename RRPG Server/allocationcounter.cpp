@@ -0,0 +1,93 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local unsigned long long threadAllocations = 0;
+	std::atomic<unsigned long long> handlerCommands(0);
+	std::atomic<unsigned long long> handlerAllocations(0);
+
+	void* CountedAllocate(size_t size)
+	{
+		threadAllocations++;
+		return malloc(size == 0 ? 1 : size);
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* p = CountedAllocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = CountedAllocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+unsigned long long AllocationCounter::GetThreadAllocations()
+{
+	return threadAllocations;
+}
+
+void AllocationCounter::AddHandlerRun(unsigned int commands, unsigned long long allocations)
+{
+	handlerCommands.fetch_add(commands, std::memory_order_relaxed);
+	handlerAllocations.fetch_add(allocations, std::memory_order_relaxed);
+}
+
+void AllocationCounter::GetHandlerTotals(unsigned long long& commands, unsigned long long& allocations)
+{
+	commands = handlerCommands.load(std::memory_order_relaxed);
+	allocations = handlerAllocations.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Counts allocations made through the global operator new, which the server replaces.
+// Workers add up what their handlers allocated so the steady state can be checked for churn.
+class AllocationCounter
+{
+public:
+	// Allocations made on the calling thread so far
+	static unsigned long long GetThreadAllocations();
+
+	static void AddHandlerRun(unsigned int commands, unsigned long long allocations);
+	static void GetHandlerTotals(unsigned long long& commands, unsigned long long& allocations);
+};
@@ -0,0 +1,40 @@
+#include "chatlimiter.h"
+
+#include <algorithm>
+
+unsigned int ChatLimiter::LINES_PER_SECOND = 2;
+unsigned int ChatLimiter::BURST = 5;
+
+namespace
+{
+	const unsigned int TOKENS_PER_LINE = 1000;
+}
+
+bool ChatLimiter::Allow(uint64_t guid, RakNet::TimeMS now, bool& isFirstRefusal)
+{
+	unsigned int capacity = BURST * TOKENS_PER_LINE;
+	auto result = buckets.emplace(guid, Bucket{ capacity, now, false });
+	Bucket& bucket = result.first->second;
+
+	// A line per second is a token per millisecond
+	uint64_t tokens = bucket.tokens + (uint64_t)(RakNet::TimeMS)(now - bucket.refilled) * LINES_PER_SECOND;
+	bucket.tokens = (unsigned int)std::min<uint64_t>(tokens, capacity);
+	bucket.refilled = now;
+
+	isFirstRefusal = false;
+	if (bucket.tokens >= TOKENS_PER_LINE)
+	{
+		bucket.tokens -= TOKENS_PER_LINE;
+		bucket.isRefusing = false;
+		return true;
+	}
+
+	isFirstRefusal = !bucket.isRefusing;
+	bucket.isRefusing = true;
+	return false;
+}
+
+void ChatLimiter::Remove(uint64_t guid)
+{
+	buckets.erase(guid);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "RakNetTime.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+// A token bucket per player for chat. Checked on the packet thread before a line is posted, so a
+// client flooding chat is cut off before its lines take mailbox room that turns need. Each player
+// may send BURST lines at once and LINES_PER_SECOND after that. Owned by the packet thread.
+class ChatLimiter
+{
+public:
+	// False if the player is out of tokens. isFirstRefusal is set on the first refusal in a row,
+	// so they can be told once rather than once per line
+	bool Allow(uint64_t guid, RakNet::TimeMS now, bool& isFirstRefusal);
+	void Remove(uint64_t guid);
+
+	static unsigned int LINES_PER_SECOND;
+	static unsigned int BURST;
+
+private:
+	struct Bucket
+	{
+		// Thousandths of a line, so a millisecond's refill is a whole number
+		unsigned int tokens;
+		RakNet::TimeMS refilled;
+		bool isRefusing;
+	};
+
+	std::unordered_map<uint64_t, Bucket> buckets;
+};
@@ -0,0 +1,66 @@
+#include "chatrelay.h"
+#include "RRPG_MessageIdentifiers.h"
+
+#include <cstring>
+
+unsigned int ChatRelay::WINDOW_MS = 50;
+unsigned int ChatRelay::MAX_MESSAGE_BYTES = 1024;
+
+namespace
+{
+	const char SEPARATOR[] = ": ";
+
+	unsigned int GetLineLength(const char* name, const char* text)
+	{
+		unsigned int length = (unsigned int)strlen(text);
+		if (name != nullptr)
+			length += (unsigned int)(strlen(name) + strlen(SEPARATOR));
+
+		return length;
+	}
+}
+
+ChatRelay::ChatRelay()
+	: lineCount(0)
+{
+}
+
+void ChatRelay::Append(const char* name, const char* text)
+{
+	// The same bytes ChatMessage::Write gives for the joined text, so clients read it as usual
+	if (lineCount == 0)
+		stream.Write((unsigned char)RRPG_ID::S_BROADCAST_CHAT);
+	else
+		stream.Write('\n');
+
+	if (name != nullptr)
+	{
+		stream.WriteAlignedBytes((const unsigned char*)name, (unsigned int)strlen(name));
+		stream.WriteAlignedBytes((const unsigned char*)SEPARATOR, (unsigned int)strlen(SEPARATOR));
+	}
+	stream.WriteAlignedBytes((const unsigned char*)text, (unsigned int)strlen(text));
+	lineCount++;
+}
+
+bool ChatRelay::HasRoomFor(const char* name, const char* text) const
+{
+	// Room for the newline before the line and the terminator after it
+	return lineCount == 0 || stream.GetNumberOfBytesUsed() + GetLineLength(name, text) + 2 <= MAX_MESSAGE_BYTES;
+}
+
+bool ChatRelay::IsEmpty() const
+{
+	return lineCount == 0;
+}
+
+const RakNet::BitStream* ChatRelay::Finish()
+{
+	stream.Write('\0');
+	return &stream;
+}
+
+void ChatRelay::Clear()
+{
+	stream.Reset();
+	lineCount = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "BitStream.h"
+
+// Gathers a match's chat lines into one S_BROADCAST_CHAT, newline separated, so a busy chat costs
+// each player one message per window instead of one per line. Lines are written straight into the
+// encoded message, which is then queued unchanged for every recipient. Only touched by its match.
+class ChatRelay
+{
+public:
+	ChatRelay();
+
+	// "name: text", or text alone when name is nullptr
+	void Append(const char* name, const char* text);
+	// False if the line would take the message past MAX_MESSAGE_BYTES, a lone line always fits
+	bool HasRoomFor(const char* name, const char* text) const;
+	bool IsEmpty() const;
+	// Terminates the message and hands it back, valid until Clear
+	const RakNet::BitStream* Finish();
+	void Clear();
+
+	// How long the first line waits for others to join it, 0 sends every line at once
+	static unsigned int WINDOW_MS;
+	static unsigned int MAX_MESSAGE_BYTES;
+
+private:
+	RakNet::BitStream stream;
+	unsigned int lineCount;
+};
@@ -0,0 +1,145 @@
+#include "log.h"
+#include "mpscqueue.h"
+
+#include "GetTime.h"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+int Log::IDLE_WAIT_MS = 5;
+
+namespace
+{
+	// Longer lines are cut short, a record is a fixed-size ring cell
+	const unsigned int MAX_TEXT_SIZE = 500;
+
+	struct LogRecord
+	{
+		RakNet::TimeMS time;
+		LogSubsystem subsystem;
+		LogLevel level;
+		char text[MAX_TEXT_SIZE];
+	};
+
+	const char* subsystemNames[LOG_SUBSYSTEM_COUNT] = { "network", "match", "chat", "server" };
+	const char* levelNames[LOG_OFF + 1] = { "debug", "info", "warning", "error", "off" };
+
+	// Pings and the like are debug, so by default only what used to be worth printing gets through
+	std::atomic<unsigned char> levels[LOG_SUBSYSTEM_COUNT] = { { LOG_INFO }, { LOG_INFO }, { LOG_INFO }, { LOG_INFO } };
+	MpscQueue<LogRecord, 2048> records;
+	std::atomic<unsigned int> dropped(0);
+	std::atomic<bool> isRunning(false);
+	std::thread writer;
+
+	void WriteRecord(const LogRecord& record)
+	{
+		printf("%6u.%03u %-7s %-7s %s\n", record.time / 1000, record.time % 1000,
+			levelNames[record.level], subsystemNames[record.subsystem], record.text);
+	}
+
+	void RunWriter()
+	{
+		LogRecord record;
+		for (;;)
+		{
+			// Read before draining so nothing pushed ahead of Stop is left behind
+			bool stopping = !isRunning;
+			bool wrote = false;
+			while (records.Pop(record))
+			{
+				WriteRecord(record);
+				wrote = true;
+			}
+
+			unsigned int lost = dropped.exchange(0);
+			if (lost > 0)
+				printf("%u log lines dropped, the ring was full\n", lost);
+
+			// One flush per burst instead of one per line
+			if (wrote || lost > 0)
+				fflush(stdout);
+
+			if (stopping)
+				return;
+
+			if (!wrote)
+				std::this_thread::sleep_for(std::chrono::milliseconds(Log::IDLE_WAIT_MS));
+		}
+	}
+}
+
+void Log::Start()
+{
+	if (isRunning.exchange(true))
+		return;
+
+	writer = std::thread(&RunWriter);
+}
+
+void Log::Stop()
+{
+	if (!isRunning.exchange(false))
+		return;
+
+	writer.join();
+}
+
+void Log::Write(LogSubsystem subsystem, LogLevel level, const char* format, ...)
+{
+	if (!IsEnabled(subsystem, level))
+		return;
+
+	LogRecord record;
+	record.time = RakNet::GetTimeMS();
+	record.subsystem = subsystem;
+	record.level = level;
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(record.text, MAX_TEXT_SIZE, format, args);
+	va_end(args);
+
+	if (!records.Push(record))
+		dropped++;
+}
+
+bool Log::IsEnabled(LogSubsystem subsystem, LogLevel level)
+{
+	return level >= levels[subsystem].load(std::memory_order_relaxed);
+}
+
+void Log::SetLevel(LogSubsystem subsystem, LogLevel level)
+{
+	levels[subsystem].store(level, std::memory_order_relaxed);
+}
+
+bool Log::FindSubsystem(const char* name, LogSubsystem& subsystem)
+{
+	for (unsigned int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+	{
+		if (strcmp(name, subsystemNames[i]) == 0)
+		{
+			subsystem = (LogSubsystem)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Log::FindLevel(const char* name, LogLevel& level)
+{
+	for (unsigned int i = 0; i <= LOG_OFF; i++)
+	{
+		if (strcmp(name, levelNames[i]) == 0)
+		{
+			level = (LogLevel)i;
+			return true;
+		}
+	}
+
+	return false;
+}
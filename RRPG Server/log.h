@@ -0,0 +1,47 @@
+#pragma once
+
+enum LogSubsystem : unsigned char
+{
+	// Connections and routing on the packet thread
+	LOG_NETWORK,
+	// Match lifecycle and game events
+	LOG_MATCH,
+	// Player chat and server broadcasts
+	LOG_CHAT,
+	// Diagnostics and console command output
+	LOG_SERVER,
+	LOG_SUBSYSTEM_COUNT
+};
+
+enum LogLevel : unsigned char
+{
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARNING,
+	LOG_ERROR,
+	LOG_OFF
+};
+
+// Asynchronous logger. Write formats the line on the calling thread and pushes it onto a lock-free
+// ring; a background thread does all the terminal I/O. Callers never block: if the ring is full
+// the line is dropped and the writer reports how many were lost.
+class Log
+{
+public:
+	// Starts the writer thread, lines written before this wait in the ring
+	static void Start();
+	// Writes out whatever is still queued and stops the writer
+	static void Stop();
+
+	static void Write(LogSubsystem subsystem, LogLevel level, const char* format, ...);
+	static bool IsEnabled(LogSubsystem subsystem, LogLevel level);
+	// Everything below level is discarded before it is formatted
+	static void SetLevel(LogSubsystem subsystem, LogLevel level);
+
+	// For the .loglevel console command, false if the name is unknown
+	static bool FindSubsystem(const char* name, LogSubsystem& subsystem);
+	static bool FindLevel(const char* name, LogLevel& level);
+
+	// How long the writer sleeps once the ring is empty
+	static int IDLE_WAIT_MS;
+};
@@ -1,7 +1,39 @@
 #include "server.h"
 
-int main()
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char* argv[])
 {
+	// rrpg_server [--seed <n>] [--record <file> | --replay <file>]
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--seed") == 0)
+			Server::Get().SetSeed(strtoull(argv[i + 1], nullptr, 10));
+		else if (strcmp(argv[i], "--record") == 0)
+			recordPath = argv[i + 1];
+		else if (strcmp(argv[i], "--replay") == 0)
+			replayPath = argv[i + 1];
+	}
+
+	if (replayPath != nullptr)
+	{
+		if (Server::Get().Replay(replayPath))
+			return 0;
+
+		printf("Could not read recording %s\n", replayPath);
+		return 1;
+	}
+
+	if (recordPath != nullptr && !Server::Get().Record(recordPath))
+	{
+		printf("Could not create recording %s\n", recordPath);
+		return 1;
+	}
+
 	Server::Get().Start();
 	return 0;
-}
\ No newline at end of file
+}
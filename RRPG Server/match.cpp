@@ -0,0 +1,678 @@
+#include "match.h"
+#include "RRPG_Messages.h"
+#include "RRPG_SendPolicy.h"
+#include "allocationcounter.h"
+#include "log.h"
+#include "matchmanager.h"
+#include "messagestats.h"
+#include "scratcharena.h"
+
+#include "BitStream.h"
+#include "GetTime.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+unsigned int Match::EXPECTED_PLAYERS = 3;
+int Match::MAX_COMMANDS_PER_RUN = 64;
+unsigned int Match::TURN_TIMEOUT_MS = 30000;
+unsigned int Match::DISCONNECTED_TURN_TIMEOUT_MS = 10000;
+unsigned int Match::MAX_MISSED_TURNS = 3;
+
+namespace
+{
+	typedef void (Match::*CommandHandler)(const MatchCommand& command);
+
+	DispatchTable<CommandHandler> MakeCommandHandlers()
+	{
+		DispatchTable<CommandHandler> table;
+		table.Set(ID_DISCONNECTION_NOTIFICATION, &Match::OnPlayerDisconnected);
+		table.Set(ID_CONNECTION_LOST, &Match::OnPlayerDisconnected);
+		table.Set(RRPG_ID::C_INTRO, &Match::OnClientIntro);
+		table.Set(RRPG_ID::C_RESUME, &Match::OnPlayerResumed);
+		table.Set(RRPG_ID::C_READY, &Match::OnPlayerReady);
+		table.Set(RRPG_ID::C_UNREADY, &Match::OnPlayerUnready);
+		table.Set(RRPG_ID::C_PLAYER_LIST_REQUEST, &Match::OnPlayerListRequest);
+		table.Set(RRPG_ID::C_PLAYER_STATS_REQUEST, &Match::OnPlayerStatsRequest);
+		table.Set(RRPG_ID::C_CHAT, &Match::OnClientChatReceived);
+		table.Set(RRPG_ID::C_JOB_CHOSEN, &Match::OnPlayerJobChosen);
+		table.Set(RRPG_ID::C_ACTION_TAKEN, &Match::OnPlayerActionTaken);
+		table.Set(MC_TURN_TIMEOUT, &Match::OnTurnTimeout);
+		table.Set(MC_CHAT_FLUSH, &Match::OnChatFlush);
+		return table;
+	}
+
+	const DispatchTable<CommandHandler> commandHandlers = MakeCommandHandlers();
+
+	unsigned int ToMicroseconds(RakNet::TimeUS elapsed)
+	{
+		return elapsed > 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned int)elapsed;
+	}
+}
+
+Match::Match(unsigned int id, uint64_t seed, RakNet::RakPeerInterface* rpi, MatchManager& manager)
+	: id(id), rpi(rpi), manager(manager), outgoing(rpi), isChatFlushArmed(false), rng(seed), gameState(GS_PENDING), pendingCommands(0), currentPlayerTurn(0), turnNumber(0), statsVersion(0), isClosed(false)
+{
+}
+
+unsigned int Match::GetID() const
+{
+	return id;
+}
+
+GameState Match::GetGameState() const
+{
+	return gameState;
+}
+
+bool Match::IsFinished() const
+{
+	return isClosed || gameState == GS_GAME_OVER || (gameState != GS_PENDING && players.GetConnectedCount() == 0);
+}
+
+bool Match::IsIdle() const
+{
+	return pendingCommands == 0;
+}
+
+void Match::Close()
+{
+	for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+	{
+		if (players.IsConnected(slot))
+		{
+			rpi->CloseConnection(players.GetAddress(slot), true);
+			players.Disconnect(slot);
+		}
+	}
+
+	isClosed = true;
+}
+
+std::vector<RakNet::RakNetGUID> Match::GetPlayerGUIDs() const
+{
+	std::vector<RakNet::RakNetGUID> guids;
+	for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+		guids.push_back(players.GetGUID(slot));
+
+	return guids;
+}
+
+bool Match::Post(const MatchCommand& command, bool& wasIdle)
+{
+	// Counted before it is queued so a worker never sees the count drop to zero with commands left.
+	// Popped commands stay counted until their run ends, so while the count is below the mailbox size
+	// there is always a free cell and a full mailbox never touches the count
+	wasIdle = false;
+	int pending = pendingCommands.load();
+	do
+	{
+		if (pending >= (int)MAILBOX_SIZE)
+			return false;
+	}
+	while (!pendingCommands.compare_exchange_weak(pending, pending + 1));
+
+	wasIdle = pending == 0;
+	bool isQueued = mailbox.Push(command);
+	assert(isQueued);
+	return isQueued;
+}
+
+bool Match::Run(bool& finished)
+{
+	int handled = 0;
+	unsigned long long allocations = AllocationCounter::GetThreadAllocations();
+	MatchCommand command;
+	while (handled < MAX_COMMANDS_PER_RUN && mailbox.Pop(command))
+	{
+		RakNet::TimeUS started = RakNet::GetTimeUS();
+		{
+			// Handler buffers come from here and are all released once the command is done
+			ScratchArena::Scope scratch;
+			if (!IsFinished())
+				HandleCommand(command);
+			// Nothing is handled once the match is over, so chat still waiting goes out now
+			if (IsFinished())
+				FlushChat();
+			ReplicateStats();
+			outgoing.Flush();
+		}
+		MessageStats::Record(command.type, ToMicroseconds(started - command.received), ToMicroseconds(RakNet::GetTimeUS() - started));
+
+		if (command.packet != nullptr)
+			rpi->DeallocatePacket(command.packet);
+		handled++;
+	}
+	AllocationCounter::AddHandlerRun(handled, AllocationCounter::GetThreadAllocations() - allocations);
+
+	finished = IsFinished();
+	return pendingCommands.fetch_sub(handled) != handled;
+}
+
+void Match::HandleCommand(const MatchCommand& command)
+{
+	CommandHandler handler = commandHandlers.Get(command.type);
+	if (handler == nullptr)
+	{
+		Log::Write(LOG_NETWORK, LOG_WARNING, "[Match %u] No handler for message %u", id, command.type);
+		return;
+	}
+
+	(this->*handler)(command);
+}
+
+void Match::OnClientIntro(const MatchCommand& command)
+{
+	char* name = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE);
+	bool ready;
+	if (!IntroRequest::Read(command.packet, name, ready) || players.FindByGUID(command.guid) != NO_PLAYER_SLOT)
+		return;
+
+	// Matchmaking seats players by the state it last saw, the game may have started since
+	if (gameState != GS_PENDING)
+	{
+		manager.ReturnToMatchmaking(id, command);
+		return;
+	}
+
+	// Names double as action targets, so they have to be unique within a match. Matchmaking keeps
+	// them apart already, this catches a player it seated before the match let go of the name
+	PlayerSlot slot = players.Add(command.guid, command.address, name);
+	if (slot == NO_PLAYER_SLOT)
+	{
+		RakNet::BitStream bs;
+		ChatMessage::Write(&bs, "[Server] That name is already taken here, finding you another match.");
+		SendWithPolicy(rpi, &bs, command.address);
+		manager.ReturnToMatchmaking(id, command);
+		return;
+	}
+
+	char* joined = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 13);
+	snprintf(joined, NAME_BUFFER_SIZE + 13, "%s has joined.", name);
+	BroadcastMessage(joined);
+
+	if (players.GetSize() != EXPECTED_PLAYERS)
+	{
+		unsigned int remaining = EXPECTED_PLAYERS - players.GetSize();
+		char buffer[40];
+		snprintf(buffer, 40, "Waiting for %i more player%s..",
+			remaining,
+			(remaining == 1 ? "." : "s.")
+		);
+		BroadcastMessage(&buffer[0]);
+	}
+
+	// Matchmaking only seats ready players, so the intro readies them too
+	SetReady(slot);
+}
+
+void Match::OnClientChatReceived(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot == NO_PLAYER_SLOT)
+		return;
+
+	char* cmsg = ScratchArena::Get().Allocate(CHAT_BUFFER_SIZE);
+	if (!ChatRequest::Read(command.packet, cmsg))
+		return;
+
+	const std::string& name = players.GetName(slot);
+	Log::Write(LOG_CHAT, LOG_INFO, "[Match %u] %s: %s", id, name.c_str(), cmsg);
+	QueueChat(name.c_str(), cmsg);
+}
+
+void Match::OnPlayerReady(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot == NO_PLAYER_SLOT || gameState != GS_PENDING)
+		return;
+
+	SetReady(slot);
+}
+
+void Match::SetReady(PlayerSlot slot)
+{
+	players.SetReady(slot, true);
+	char* msg = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 10);
+	snprintf(msg, NAME_BUFFER_SIZE + 10, "%s is ready.", players.GetName(slot).c_str());
+	BroadcastMessage(msg);
+
+	if (players.AreAllReady() && players.GetSize() == EXPECTED_PLAYERS)
+		StartGame();
+}
+
+void Match::OnPlayerUnready(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot == NO_PLAYER_SLOT || gameState != GS_PENDING)
+		return;
+
+	players.SetReady(slot, false);
+	char* msg = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 14);
+	snprintf(msg, NAME_BUFFER_SIZE + 14, "%s is not ready.", players.GetName(slot).c_str());
+	BroadcastMessage(msg);
+}
+
+void Match::OnPlayerListRequest(const MatchCommand& command)
+{
+	unsigned int version = players.GetRosterVersion();
+	if (command.knownVersion == version)
+	{
+		ReplyNotModified(command);
+		return;
+	}
+
+	// Lobby polling mostly asks for the same list again, so it is encoded once per version
+	if (listReply.version != version)
+	{
+		RakNet::BitStream& bs = listReply.stream;
+		bs.Reset();
+		PlayerListMessage::Write(&bs, version, players.GetSize());
+		for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+			PlayerListEntry::Write(&bs, players.GetName(slot).c_str(), players.IsReady(slot));
+		listReply.version = version;
+	}
+
+	Reply(command, &listReply.stream);
+}
+
+void Match::OnPlayerJobChosen(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot == NO_PLAYER_SLOT || slot != currentPlayerTurn)
+		return;
+
+	missedTurns[slot] = 0;
+	players.SetReady(slot, true);
+	players.SetJob(slot, command.job);
+
+	RakNet::BitStream event;
+	JobChosenMessage::Write(&event, slot, command.job);
+	Broadcast(&event);
+
+	NextCharacterSelectTurn();
+}
+
+void Match::OnPlayerStatsRequest(const MatchCommand& command)
+{
+	// Clients keep their own copy from S_PLAYER_STATS_DELTA, this only resyncs one that lost track
+	if (command.knownVersion == statsVersion)
+	{
+		ReplyNotModified(command);
+		return;
+	}
+
+	if (statsReply.version != statsVersion)
+	{
+		RakNet::BitStream& bs = statsReply.stream;
+		bs.Reset();
+		PlayerStatsSnapshotMessage::Write(&bs, statsVersion, players.GetSize());
+		for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+			PlayerStatsEntry::Write(&bs, GetPlayerStats(slot, STAT_ALL));
+		statsReply.version = statsVersion;
+	}
+
+	Reply(command, &statsReply.stream);
+}
+
+void Match::OnPlayerActionTaken(const MatchCommand& command)
+{
+	Action action = command.action;
+	PlayerSlot target = command.target;
+	PlayerSlot origin = players.FindByGUID(command.guid);
+	if (target >= players.GetSize() || origin != currentPlayerTurn || gameState != GS_MAIN)
+		return;
+
+	missedTurns[origin] = 0;
+
+	// Heals are positive, attacks negative
+	int amount = 0;
+	switch (action)
+	{
+	case Action::Heal:
+		amount = 10;
+		break;
+	case Action::HealRng:
+		amount = rng.GetInteger(5, 15);
+		break;
+	case Action::Attack:
+		amount = -12;
+		break;
+	case Action::AtkRng:
+		amount = -rng.GetInteger(6, 18);
+		break;
+	default:
+		return;
+	}
+
+	// -> OnPlayerActionTaken, the client words it
+	RakNet::BitStream event;
+	ActionTakenMessage::Write(&event, origin, action, target, amount);
+	Broadcast(&event);
+
+	ModifyHealth(target, amount);
+
+	NextTurn();
+}
+
+void Match::OnPlayerDisconnected(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot == NO_PLAYER_SLOT)
+		return;
+
+	char* msg = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 10);
+	snprintf(msg, NAME_BUFFER_SIZE + 10, "%s has left.", players.GetName(slot).c_str());
+
+	if (gameState == GS_PENDING)
+	{
+		players.Remove(slot);
+		BroadcastMessage(msg);
+		return;
+	}
+
+	// Mid-game their slot stays so turn order is kept
+	players.Disconnect(slot);
+	if (command.type == ID_CONNECTION_LOST)
+	{
+		// They may resume, until then their turns run out early and MAX_MISSED_TURNS of them forfeit
+		snprintf(msg, NAME_BUFFER_SIZE + 10, "%s dropped.", players.GetName(slot).c_str());
+		BroadcastMessage(msg);
+		if (slot == currentPlayerTurn)
+			TakeTurn(slot);
+		return;
+	}
+
+	BroadcastMessage(msg);
+	Forfeit(slot);
+}
+
+void Match::OnPlayerResumed(const MatchCommand& command)
+{
+	PlayerSlot slot = players.FindByGUID(command.resumedGUID);
+	if (slot == NO_PLAYER_SLOT || gameState == GS_PENDING)
+	{
+		RakNet::BitStream bs;
+		ResumeRejectedMessage::Write(&bs);
+		SendWithPolicy(rpi, &bs, command.address);
+		return;
+	}
+
+	// The client can notice the drop before the server does, its old connection is replaced
+	if (players.IsConnected(slot) && players.GetAddress(slot) != command.address)
+		rpi->CloseConnection(players.GetAddress(slot), false);
+	players.Rebind(slot, command.guid, command.address);
+	missedTurns[slot] = 0;
+	Log::Write(LOG_MATCH, LOG_INFO, "[Match %u] %s resumed from %s", id, players.GetName(slot).c_str(), command.address.ToString(true));
+
+	SendSnapshot(slot);
+
+	char* msg = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 17);
+	snprintf(msg, NAME_BUFFER_SIZE + 17, "%s has reconnected.", players.GetName(slot).c_str());
+	BroadcastMessage(msg);
+
+	// Their turn may have come round while they were away, it gets a fresh deadline
+	if (slot == currentPlayerTurn && !players.IsDead(slot))
+		TakeTurn(slot);
+}
+
+void Match::OnTurnTimeout(const MatchCommand& command)
+{
+	if (command.turn != turnNumber || (gameState != GS_CHARACTER_SELECT && gameState != GS_MAIN))
+		return;
+
+	PlayerSlot slot = currentPlayerTurn;
+	Log::Write(LOG_MATCH, LOG_INFO, "[Match %u] %s let turn %u run out", id, players.GetName(slot).c_str(), turnNumber);
+	RakNet::BitStream event;
+	TurnTimedOutMessage::Write(&event, slot);
+	Broadcast(&event);
+
+	if (++missedTurns[slot] >= MAX_MISSED_TURNS)
+	{
+		char* msg = ScratchArena::Get().Allocate(NAME_BUFFER_SIZE + 15);
+		snprintf(msg, NAME_BUFFER_SIZE + 15, "%s has forfeited.", players.GetName(slot).c_str());
+		BroadcastMessage(msg);
+		Forfeit(slot);
+		return;
+	}
+
+	if (gameState == GS_CHARACTER_SELECT)
+	{
+		// Everyone needs a job before the main game, so one is picked for them
+		CharacterClass job = (CharacterClass)rng.GetInteger((int)CharacterClass::Wizard, (int)CharacterClass::Assassin);
+		players.SetReady(slot, true);
+		players.SetJob(slot, job);
+
+		RakNet::BitStream chosen;
+		JobChosenMessage::Write(&chosen, slot, job);
+		Broadcast(&chosen);
+
+		NextCharacterSelectTurn();
+	}
+	else
+		NextTurn();
+}
+
+void Match::OnChatFlush(const MatchCommand& command)
+{
+	isChatFlushArmed = false;
+	FlushChat();
+}
+
+void Match::NextTurn()
+{
+	currentPlayerTurn = players.NextAlive(currentPlayerTurn);
+
+	if (players.GetAliveCount() == 1)
+	{
+		GameOver(currentPlayerTurn);
+		return;
+	}
+
+	RakNet::BitStream event;
+	TurnChangedMessage::Write(&event, currentPlayerTurn);
+	Broadcast(&event);
+
+	TakeTurn(currentPlayerTurn);
+}
+
+void Match::NextCharacterSelectTurn()
+{
+	PlayerSlot next = players.NextAlive(currentPlayerTurn);
+
+	// Everyone has picked once the ring wraps back around
+	if (next == NO_PLAYER_SLOT || next <= currentPlayerTurn)
+	{
+		// Main game turns start from whoever follows the last slot
+		currentPlayerTurn = (PlayerSlot)(players.GetSize() - 1);
+		StartMainGame();
+	}
+	else
+	{
+		currentPlayerTurn = next;
+		TakeTurn(currentPlayerTurn);
+	}
+}
+
+void Match::ModifyHealth(PlayerSlot slot, int diff)
+{
+	int health = std::max(0, std::min(MAX_HEALTH, players.GetHealth(slot) + diff));
+	const std::string& name = players.GetName(slot);
+	players.SetHealth(slot, health);
+	if (health > 0)
+		Log::Write(LOG_MATCH, LOG_INFO, "[Match %u] %s is now at %i health", id, name.c_str(), health);
+	else
+	{
+		Log::Write(LOG_MATCH, LOG_INFO, "[Match %u] %s is dead", id, name.c_str());
+		players.Kill(slot);
+	}
+}
+
+void Match::Forfeit(PlayerSlot slot)
+{
+	players.Kill(slot);
+
+	if (gameState == GS_GAME_OVER)
+		return;
+
+	if (players.GetAliveCount() <= 1)
+	{
+		PlayerSlot winner = players.GetFirstAlive();
+		if (winner != NO_PLAYER_SLOT)
+			GameOver(winner);
+		else
+			gameState = GS_GAME_OVER;
+		return;
+	}
+
+	if (currentPlayerTurn == slot)
+	{
+		if (gameState == GS_CHARACTER_SELECT)
+			NextCharacterSelectTurn();
+		else
+			NextTurn();
+	}
+}
+
+void Match::ReplicateStats()
+{
+	const std::vector<PlayerSlot>& dirtySlots = players.GetDirtySlots();
+	if (dirtySlots.empty())
+		return;
+
+	statsVersion++;
+	RakNet::BitStream bs;
+	PlayerStatsDeltaMessage::Write(&bs, statsVersion, (unsigned int)dirtySlots.size());
+	for (PlayerSlot slot : dirtySlots)
+		PlayerStatsEntry::Write(&bs, GetPlayerStats(slot, players.GetDirtyStats(slot)));
+
+	players.ClearDirtyStats();
+	Broadcast(&bs);
+}
+
+PlayerStats Match::GetPlayerStats(PlayerSlot slot, unsigned char stats) const
+{
+	return PlayerStats{ slot, stats, players.GetHealth(slot), players.GetJob(slot), players.IsDead(slot) };
+}
+
+void Match::StartGame()
+{
+	Log::Write(LOG_MATCH, LOG_INFO, "[Match %u] Game has started.", id);
+	gameState = GS_CHARACTER_SELECT;
+	// Events refer to players by slot from here on, so send the roster in slot order
+	RakNet::BitStream bs;
+	GameStartedMessage::Write(&bs, players.GetSize());
+	for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+		RosterEntry::Write(&bs, players.GetName(slot).c_str());
+	Broadcast(&bs);
+
+	players.SetAllReady(false);
+	missedTurns.assign(players.GetSize(), 0);
+	currentPlayerTurn = 0;
+
+	TakeTurn(currentPlayerTurn);
+}
+
+void Match::StartMainGame()
+{
+	gameState = GS_MAIN;
+	// Clients already have the roster and every job from the stats stream
+	RakNet::BitStream gsBs;
+	GameStateMessage::Write(&gsBs, gameState);
+	Broadcast(&gsBs);
+	NextTurn();
+}
+
+void Match::GameOver(PlayerSlot winner)
+{
+	gameState = GS_GAME_OVER;
+	RakNet::BitStream bs;
+	GameOverMessage::Write(&bs, gameState, winner);
+	Broadcast(&bs);
+}
+
+void Match::TakeTurn(PlayerSlot slot)
+{
+	// Armed even for a player who has gone, the turn still has to move on
+	unsigned int timeout = players.IsConnected(slot) ? TURN_TIMEOUT_MS : DISCONNECTED_TURN_TIMEOUT_MS;
+	manager.ArmTurnTimer(id, ++turnNumber, RakNet::GetTimeMS() + timeout);
+
+	if (!players.IsConnected(slot))
+		return;
+
+	RakNet::BitStream ttBs;
+	TakeTurnMessage::Write(&ttBs);
+	outgoing.Queue(slot, players.GetAddress(slot), &ttBs);
+}
+
+void Match::SendSnapshot(PlayerSlot slot)
+{
+	// Stats are at statsVersion here, the deltas that follow build on it
+	RakNet::BitStream bs;
+	MatchSnapshotMessage::Write(&bs, gameState, slot, currentPlayerTurn, statsVersion, players.GetSize());
+	for (PlayerSlot entry = 0; entry < players.GetSize(); entry++)
+		SnapshotEntry::Write(&bs, players.GetName(entry).c_str(), GetPlayerStats(entry, STAT_ALL));
+
+	outgoing.Queue(slot, players.GetAddress(slot), &bs);
+}
+
+void Match::Reply(const MatchCommand& command, const RakNet::BitStream* bs)
+{
+	PlayerSlot slot = players.FindByGUID(command.guid);
+	if (slot != NO_PLAYER_SLOT)
+		outgoing.Queue(slot, command.address, bs);
+	else
+		SendWithPolicy(rpi, bs, command.address);
+}
+
+void Match::ReplyNotModified(const MatchCommand& command)
+{
+	RakNet::BitStream bs;
+	NotModifiedMessage::Write(&bs, command.type);
+	Reply(command, &bs);
+}
+
+void Match::Broadcast(const RakNet::BitStream* bs)
+{
+	for (PlayerSlot slot = 0; slot < players.GetSize(); slot++)
+		if (players.IsConnected(slot))
+			outgoing.Queue(slot, players.GetAddress(slot), bs);
+}
+
+void Match::QueueChat(const char* name, const char* text)
+{
+	if (!chat.HasRoomFor(name, text))
+		FlushChat();
+
+	chat.Append(name, text);
+	if (ChatRelay::WINDOW_MS == 0)
+		FlushChat();
+	else if (!isChatFlushArmed)
+	{
+		isChatFlushArmed = true;
+		manager.ArmChatFlush(id, RakNet::GetTimeMS() + ChatRelay::WINDOW_MS);
+	}
+}
+
+void Match::FlushChat()
+{
+	if (chat.IsEmpty())
+		return;
+
+	// Encoded once, every recipient gets the same bytes
+	Broadcast(chat.Finish());
+	chat.Clear();
+}
+
+void Match::BroadcastMessage(const char* input)
+{
+	if (strlen(input) == 0)
+		return;
+
+	const static char prefix[] = "[Server] ";
+	char* message = ScratchArena::Get().Allocate(strlen(prefix) + strlen(input) + 1);
+	memcpy(message, prefix, strlen(prefix));
+	memcpy(message + strlen(prefix), input, strlen(input) + 1);
+	Log::Write(LOG_CHAT, LOG_INFO, "[Match %u] %s", id, message);
+	QueueChat(nullptr, message);
+}
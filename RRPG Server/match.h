@@ -0,0 +1,131 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_MessageIdentifiers.h"
+#include "RRPG_Messages.h"
+#include "chatrelay.h"
+#include "matchcommand.h"
+#include "matchrandom.h"
+#include "mpscqueue.h"
+#include "outgoingbatch.h"
+#include "playertable.h"
+
+#include "RakPeerInterface.h"
+#include "BitStream.h"
+#include <string>
+#include <vector>
+#include <atomic>
+
+class MatchManager;
+
+class Match
+{
+public:
+	// Every random roll in the match comes from seed, turn deadlines are armed through manager
+	Match(unsigned int id, uint64_t seed, RakNet::RakPeerInterface* rpi, MatchManager& manager);
+
+	unsigned int GetID() const;
+	GameState GetGameState() const;
+	// Game is over or every player has left, safe to tear down
+	bool IsFinished() const;
+	// No commands queued or being handled, only then may another thread touch the match
+	bool IsIdle() const;
+	void Close();
+	std::vector<RakNet::RakNetGUID> GetPlayerGUIDs() const;
+
+	// Safe from any thread. Returns false if the mailbox is full, otherwise the match owns the
+	// command's packet and wasIdle says whether it has to be scheduled
+	bool Post(const MatchCommand& command, bool& wasIdle);
+	// Applies queued commands in arrival order, returns true if more are still waiting
+	bool Run(bool& finished);
+
+	void OnClientIntro(const MatchCommand& command);
+	void OnClientChatReceived(const MatchCommand& command);
+	void OnPlayerReady(const MatchCommand& command);
+	void OnPlayerUnready(const MatchCommand& command);
+	// RequestPlayersFromServer ->
+	void OnPlayerListRequest(const MatchCommand& command);
+	void OnPlayerJobChosen(const MatchCommand& command);
+	// RequestPlayerStatsFromServer ->
+	void OnPlayerStatsRequest(const MatchCommand& command);
+	void OnPlayerActionTaken(const MatchCommand& command);
+	// Mid-game a lost connection keeps the player's slot for them to resume, leaving forfeits
+	void OnPlayerDisconnected(const MatchCommand& command);
+	// C_RESUME: rebinds the slot to the new connection and sends it a snapshot of the match
+	void OnPlayerResumed(const MatchCommand& command);
+	// MC_TURN_TIMEOUT: picks a job for the player or skips their turn, and forfeits them after
+	// MAX_MISSED_TURNS in a row
+	void OnTurnTimeout(const MatchCommand& command);
+	// MC_CHAT_FLUSH: the chat window closed, send what it gathered
+	void OnChatFlush(const MatchCommand& command);
+
+	void BroadcastMessage(const char* input);
+
+	static unsigned int EXPECTED_PLAYERS;
+	static int MAX_COMMANDS_PER_RUN;
+	static unsigned int TURN_TIMEOUT_MS;
+	// Turns of a player whose connection dropped run out this soon instead, so the others are not
+	// held up while they reconnect
+	static unsigned int DISCONNECTED_TURN_TIMEOUT_MS;
+	static unsigned int MAX_MISSED_TURNS;
+
+private:
+	void HandleCommand(const MatchCommand& command);
+	// -> OnTakeTurn
+	void NextTurn();
+	void NextCharacterSelectTurn();
+	void ModifyHealth(PlayerSlot slot, int diff);
+	// Starts the game once everyone is ready and the lobby is full
+	void SetReady(PlayerSlot slot);
+	// Mid-game the slot is kept so turn order holds, the player just stops taking turns
+	void Forfeit(PlayerSlot slot);
+	// -> OnPlayerStatsDelta, sends whatever stats the command changed
+	void ReplicateStats();
+	PlayerStats GetPlayerStats(PlayerSlot slot, unsigned char stats) const;
+
+	void StartGame();
+	void StartMainGame();
+	void GameOver(PlayerSlot winner);
+	// Sends are queued and go out together once the current command is done. Also starts the turn's deadline
+	void TakeTurn(PlayerSlot slot);
+	// -> OnMatchSnapshot
+	void SendSnapshot(PlayerSlot slot);
+	void Reply(const MatchCommand& command, const RakNet::BitStream* bs);
+	void ReplyNotModified(const MatchCommand& command);
+	void Broadcast(const RakNet::BitStream* bs);
+	// Lines wait in the relay until the window armed by the first of them closes
+	void QueueChat(const char* name, const char* text);
+	void FlushChat();
+
+private:
+	static const unsigned int MAILBOX_SIZE = 128;
+
+	// An encoded reply, valid while version matches the state it was built from
+	struct CachedReply
+	{
+		// Nothing has been encoded yet
+		unsigned int version = (unsigned int)-1;
+		RakNet::BitStream stream;
+	};
+
+	unsigned int id;
+	RakNet::RakPeerInterface* rpi;
+	MatchManager& manager;
+	OutgoingBatch outgoing;
+	ChatRelay chat;
+	// An MC_CHAT_FLUSH is on its way, lines queued until then go out with it
+	bool isChatFlushArmed;
+	MatchRandom rng;
+	std::atomic<GameState> gameState;
+	MpscQueue<MatchCommand, MAILBOX_SIZE> mailbox;
+	std::atomic<int> pendingCommands;
+	PlayerTable players;
+	PlayerSlot currentPlayerTurn;
+	// Counts every turn handed out, a timeout only applies to the turn it was armed for
+	unsigned int turnNumber;
+	// Turns each slot has let run out in a row
+	std::vector<unsigned char> missedTurns;
+	unsigned int statsVersion;
+	CachedReply listReply;
+	CachedReply statsReply;
+	bool isClosed;
+};
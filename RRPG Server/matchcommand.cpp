@@ -0,0 +1,78 @@
+#include "matchcommand.h"
+#include "RRPG_Messages.h"
+
+#include "GetTime.h"
+
+bool DecodeMatchCommand(RakNet::Packet* p, MatchCommand& command)
+{
+	command.type = GetPacketIdentifier(p);
+	command.guid = p->guid;
+	command.address = p->systemAddress;
+	command.job = CharacterClass::Wizard;
+	command.action = Action::Heal;
+	command.target = NO_PLAYER_SLOT;
+	command.knownVersion = 0;
+	command.turn = 0;
+	command.resumeToken = 0;
+	command.resumedGUID = RakNet::UNASSIGNED_RAKNET_GUID;
+	command.received = RakNet::GetTimeUS();
+	command.packet = p;
+
+	switch (command.type)
+	{
+	case RRPG_ID::C_JOB_CHOSEN:
+		return JobChosenRequest::Read(p, command.job);
+	case RRPG_ID::C_ACTION_TAKEN:
+		return ActionRequest::Read(p, command.action, command.target);
+	case RRPG_ID::C_PLAYER_LIST_REQUEST:
+		return PlayerListRequest::Read(p, command.knownVersion);
+	case RRPG_ID::C_PLAYER_STATS_REQUEST:
+		return PlayerStatsRequest::Read(p, command.knownVersion);
+	case RRPG_ID::C_RESUME:
+		return ResumeRequest::Read(p, command.resumeToken);
+	case MC_TURN_TIMEOUT:
+	case MC_CHAT_FLUSH:
+		return false;
+	default:
+		return true;
+	}
+}
+
+namespace
+{
+	void MakeServerCommand(unsigned char type, unsigned int turn, MatchCommand& command)
+	{
+		command.type = type;
+		command.guid = RakNet::UNASSIGNED_RAKNET_GUID;
+		command.address = RakNet::UNASSIGNED_SYSTEM_ADDRESS;
+		command.job = CharacterClass::Wizard;
+		command.action = Action::Heal;
+		command.target = NO_PLAYER_SLOT;
+		command.knownVersion = 0;
+		command.turn = turn;
+		command.resumeToken = 0;
+		command.resumedGUID = RakNet::UNASSIGNED_RAKNET_GUID;
+		command.received = RakNet::GetTimeUS();
+		command.packet = nullptr;
+	}
+}
+
+void MakeTurnTimeoutCommand(unsigned int turn, MatchCommand& command)
+{
+	MakeServerCommand(MC_TURN_TIMEOUT, turn, command);
+}
+
+void MakeChatFlushCommand(MatchCommand& command)
+{
+	MakeServerCommand(MC_CHAT_FLUSH, 0, command);
+}
+
+const char* GetCommandName(unsigned char type)
+{
+	if (type == MC_TURN_TIMEOUT)
+		return "MC_TURN_TIMEOUT";
+	if (type == MC_CHAT_FLUSH)
+		return "MC_CHAT_FLUSH";
+
+	return GetMessageName(type);
+}
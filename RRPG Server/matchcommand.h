@@ -0,0 +1,47 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_MessageIdentifiers.h"
+
+#include "RakNetTypes.h"
+#include "RakNetTime.h"
+
+// Commands the server raises itself rather than decoding off the wire, numbered from the top of
+// the identifier range. A packet claiming one of these is rejected as malformed
+enum MatchCommandType : unsigned char
+{
+	// The player whose turn it is let its deadline pass
+	MC_TURN_TIMEOUT = 0xFF,
+	// The match's chat coalescing window closed
+	MC_CHAT_FLUSH = 0xFE
+};
+
+// What the packet thread hands a match: the fixed-size fields are decoded up front, intro names and
+// chat text are left in the packet for the match to decode on its own thread. The match frees the packet.
+struct MatchCommand
+{
+	unsigned char type;
+	RakNet::RakNetGUID guid;
+	RakNet::SystemAddress address;
+	CharacterClass job;
+	Action action;
+	PlayerSlot target;
+	// List and stats requests carry the last version the client saw
+	unsigned int knownVersion;
+	// Turn timeouts carry the turn they were armed for, so a late one is ignored
+	unsigned int turn;
+	// C_RESUME carries the client's token, MatchManager fills in the GUID the player had before
+	uint64_t resumeToken;
+	RakNet::RakNetGUID resumedGUID;
+	// When Receive() handed the packet over, for MessageStats
+	RakNet::TimeUS received;
+	// nullptr for commands the server raised itself
+	RakNet::Packet* packet;
+};
+
+// Returns false if the packet is too short for its message type
+bool DecodeMatchCommand(RakNet::Packet* p, MatchCommand& command);
+// Fill in commands the server raises for the match itself
+void MakeTurnTimeoutCommand(unsigned int turn, MatchCommand& command);
+void MakeChatFlushCommand(MatchCommand& command);
+// GetMessageName that also knows the server's own commands
+const char* GetCommandName(unsigned char type);
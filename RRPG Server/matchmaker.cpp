@@ -0,0 +1,297 @@
+#include "matchmaker.h"
+#include "RRPG_Messages.h"
+#include "log.h"
+
+#include <algorithm>
+
+int Matchmaker::PING_BUCKET_LIMITS_MS[PING_BUCKET_COUNT - 1] = { 50, 100, 200 };
+bool Matchmaker::IS_PING_BUCKETED = true;
+unsigned int Matchmaker::MAX_BUCKET_WAIT_MS = 2000;
+
+Matchmaker::Matchmaker()
+	: readyCount(0), nextSequence(0)
+{
+	for (unsigned int& count : readyCounts)
+		count = 0;
+}
+
+bool Matchmaker::Add(const MatchCommand& intro, RakNet::TimeMS now, int ping)
+{
+	// The match decodes the name again, this only needs to know whether the player came in ready
+	char name[NAME_BUFFER_SIZE];
+	bool isReady;
+	if (!IntroRequest::Read(intro.packet, name, isReady))
+		return false;
+
+	auto result = tickets.emplace(intro.guid.g, Ticket());
+	if (!result.second)
+		return false;
+
+	Ticket& ticket = result.first->second;
+	ticket.intro = intro;
+	ticket.name = name;
+	ticket.isReady = false;
+	ticket.bucket = 0;
+	ticket.sequence = 0;
+	ticket.readySince = now;
+	if (isReady)
+		SetReady(intro.guid, true, now, ping);
+	return true;
+}
+
+bool Matchmaker::Requeue(const MatchCommand& intro, RakNet::TimeMS now)
+{
+	char name[NAME_BUFFER_SIZE];
+	bool isReady;
+	if (!IntroRequest::Read(intro.packet, name, isReady))
+		return false;
+
+	auto result = tickets.emplace(intro.guid.g, Ticket());
+	if (!result.second)
+		return false;
+
+	Ticket& ticket = result.first->second;
+	ticket.intro = intro;
+	ticket.name = name;
+	ticket.readySince = now;
+	Push(ticket, SHARED_BUCKET);
+	return true;
+}
+
+bool Matchmaker::IsQueued(RakNet::RakNetGUID guid) const
+{
+	return tickets.find(guid.g) != tickets.end();
+}
+
+void Matchmaker::SetReady(RakNet::RakNetGUID guid, bool isReady, RakNet::TimeMS now, int ping)
+{
+	auto it = tickets.find(guid.g);
+	if (it == tickets.end() || it->second.isReady == isReady)
+		return;
+
+	Ticket& ticket = it->second;
+	if (!isReady)
+	{
+		// Its queue entry is left behind and skipped once it reaches the front
+		ticket.isReady = false;
+		readyCounts[ticket.bucket]--;
+		readyCount--;
+		return;
+	}
+
+	ticket.readySince = now;
+	Push(ticket, GetBucket(ping));
+}
+
+bool Matchmaker::Remove(RakNet::RakNetGUID guid, MatchCommand& intro)
+{
+	auto it = tickets.find(guid.g);
+	if (it == tickets.end())
+		return false;
+
+	if (it->second.isReady)
+	{
+		readyCounts[it->second.bucket]--;
+		readyCount--;
+	}
+
+	intro = it->second.intro;
+	tickets.erase(it);
+	return true;
+}
+
+void Matchmaker::FormGroups(RakNet::TimeMS now, unsigned int groupSize, std::vector<MatchCommand>& intros)
+{
+	for (unsigned char bucket = 0; bucket < PING_BUCKET_COUNT; bucket++)
+	{
+		// Stops early if the rest share names with each other
+		while (readyCounts[bucket] >= groupSize)
+		{
+			if (!TakeGroup(bucket, now, groupSize, intros))
+				break;
+		}
+
+		for (Ticket* ticket = Front(bucket); ticket != nullptr && now - ticket->readySince >= MAX_BUCKET_WAIT_MS; ticket = Front(bucket))
+		{
+			Pop(bucket);
+			readyCounts[bucket]--;
+			readyCount--;
+			Push(*ticket, SHARED_BUCKET);
+		}
+	}
+
+	// Whoever gave up on their bucket is grouped with whoever has waited longest anywhere
+	while (readyCounts[SHARED_BUCKET] > 0 && readyCount >= groupSize)
+	{
+		if (!TakeGroup(ANY_BUCKET, now, groupSize, intros))
+			break;
+	}
+}
+
+bool Matchmaker::PopOldest(MatchCommand& intro, RakNet::TimeMS now, const std::vector<std::string>& names)
+{
+	Ticket* ticket = FindOldest(names);
+	if (ticket == nullptr)
+		return false;
+
+	intro = Take(*ticket, now);
+	return true;
+}
+
+unsigned int Matchmaker::GetReadyCount() const
+{
+	return readyCount;
+}
+
+size_t Matchmaker::GetQueuedCount() const
+{
+	return tickets.size();
+}
+
+int Matchmaker::GetDelay(RakNet::TimeMS now) const
+{
+	int delay = -1;
+	for (unsigned char bucket = 0; bucket < PING_BUCKET_COUNT; bucket++)
+	{
+		const Ticket* ticket = Front(bucket);
+		if (ticket == nullptr)
+			continue;
+
+		int remaining = (int)(ticket->readySince + MAX_BUCKET_WAIT_MS - now);
+		if (remaining < 0)
+			remaining = 0;
+		if (delay < 0 || remaining < delay)
+			delay = remaining;
+	}
+
+	return delay;
+}
+
+void Matchmaker::Print() const
+{
+	Log::Write(LOG_SERVER, LOG_INFO, "Matchmaking: %u queued, %u ready, waited p50 %u ms, p99 %u ms, max %u ms over %llu players",
+		(unsigned int)tickets.size(), readyCount, waits.GetPercentile(50.0), waits.GetPercentile(99.0), waits.GetMax(), waits.GetCount());
+}
+
+unsigned char Matchmaker::GetBucket(int ping) const
+{
+	if (!IS_PING_BUCKETED)
+		return 0;
+
+	// GetAveragePing is -1 until the connection has been measured
+	if (ping >= 0)
+		for (unsigned char bucket = 0; bucket < PING_BUCKET_COUNT - 1; bucket++)
+			if (ping <= PING_BUCKET_LIMITS_MS[bucket])
+				return bucket;
+
+	return PING_BUCKET_COUNT - 1;
+}
+
+void Matchmaker::Push(Ticket& ticket, unsigned char bucket)
+{
+	ticket.isReady = true;
+	ticket.bucket = bucket;
+	ticket.sequence = ++nextSequence;
+	buckets[bucket].push_back(Entry{ ticket.intro.guid.g, ticket.sequence });
+	readyCounts[bucket]++;
+	readyCount++;
+}
+
+Matchmaker::Ticket* Matchmaker::Front(unsigned char bucket)
+{
+	std::deque<Entry>& queue = buckets[bucket];
+	while (!queue.empty())
+	{
+		auto it = tickets.find(queue.front().guid);
+		if (it != tickets.end() && it->second.isReady && it->second.sequence == queue.front().sequence)
+			return &it->second;
+
+		queue.pop_front();
+	}
+
+	return nullptr;
+}
+
+const Matchmaker::Ticket* Matchmaker::Front(unsigned char bucket) const
+{
+	// Stale entries are only skipped here, the next FormGroups drops them
+	for (const Entry& entry : buckets[bucket])
+	{
+		auto it = tickets.find(entry.guid);
+		if (it != tickets.end() && it->second.isReady && it->second.sequence == entry.sequence)
+			return &it->second;
+	}
+
+	return nullptr;
+}
+
+void Matchmaker::Pop(unsigned char bucket)
+{
+	buckets[bucket].pop_front();
+}
+
+Matchmaker::Ticket* Matchmaker::Find(unsigned char bucket, const std::vector<std::string>& names)
+{
+	// Front drops stale entries, past it they are only skipped
+	if (Front(bucket) == nullptr)
+		return nullptr;
+
+	for (const Entry& entry : buckets[bucket])
+	{
+		auto it = tickets.find(entry.guid);
+		if (it == tickets.end() || !it->second.isReady || it->second.sequence != entry.sequence)
+			continue;
+
+		if (std::find(names.begin(), names.end(), it->second.name) == names.end())
+			return &it->second;
+	}
+
+	return nullptr;
+}
+
+Matchmaker::Ticket* Matchmaker::FindOldest(const std::vector<std::string>& names)
+{
+	// Players who gave up on their bucket have waited longest already
+	Ticket* ticket = Find(SHARED_BUCKET, names);
+	if (ticket != nullptr)
+		return ticket;
+
+	for (unsigned char bucket = 0; bucket < PING_BUCKET_COUNT; bucket++)
+	{
+		Ticket* candidate = Find(bucket, names);
+		if (candidate != nullptr && (ticket == nullptr || (int)(candidate->readySince - ticket->readySince) < 0))
+			ticket = candidate;
+	}
+
+	return ticket;
+}
+
+bool Matchmaker::TakeGroup(unsigned char bucket, RakNet::TimeMS now, unsigned int groupSize, std::vector<MatchCommand>& intros)
+{
+	group.clear();
+	groupNames.clear();
+	for (unsigned int i = 0; i < groupSize; i++)
+	{
+		Ticket* ticket = bucket == ANY_BUCKET ? FindOldest(groupNames) : Find(bucket, groupNames);
+		if (ticket == nullptr)
+			return false;
+
+		group.push_back(ticket);
+		groupNames.push_back(ticket->name);
+	}
+
+	// Their queue entries go stale and are dropped once they reach the front
+	for (Ticket* ticket : group)
+		intros.push_back(Take(*ticket, now));
+	return true;
+}
+
+MatchCommand Matchmaker::Take(Ticket& ticket, RakNet::TimeMS now)
+{
+	waits.Record(now - ticket.readySince);
+	readyCounts[ticket.bucket]--;
+	readyCount--;
+	MatchCommand intro = ticket.intro;
+	tickets.erase(intro.guid.g);
+	return intro;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "matchcommand.h"
+#include "RRPG_Histogram.h"
+
+#include "RakNetTime.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Players wait here between their intro and a match forming around them. Ready players queue in
+// arrival order, split by measured ping so a match is made of players with similar latency; whoever
+// has waited MAX_BUCKET_WAIT_MS gives up on their bucket and is matched with whoever has waited
+// longest anywhere, so no one waits on a quiet bucket for long. Names are unique within a match, so
+// a group never holds two players of the same name; whoever would be the second waits for the next.
+// Every operation is O(1) apart from the groups it hands out and the duplicates skipped to make them.
+// Owned by the packet thread.
+class Matchmaker
+{
+public:
+	Matchmaker();
+
+	// Takes ownership of the intro's packet. False if the player is already queued or the intro is
+	// malformed, the caller still owns the packet then
+	bool Add(const MatchCommand& intro, RakNet::TimeMS now, int ping);
+	// Takes back a player a match could not seat, ready and in the shared pool since they have waited
+	// once already. False if the player is already queued, the caller still owns the packet then
+	bool Requeue(const MatchCommand& intro, RakNet::TimeMS now);
+	bool IsQueued(RakNet::RakNetGUID guid) const;
+	// C_READY and C_UNREADY while queued, ping is measured again each time the player readies
+	void SetReady(RakNet::RakNetGUID guid, bool isReady, RakNet::TimeMS now, int ping);
+	// Leaves the queue, handing back the intro so the caller can free its packet
+	bool Remove(RakNet::RakNetGUID guid, MatchCommand& intro);
+
+	// Moves players who waited too long into the shared pool, then appends every full group of
+	// groupSize intros it can make, oldest first within a group
+	void FormGroups(RakNet::TimeMS now, unsigned int groupSize, std::vector<MatchCommand>& intros);
+	// The ready player who has waited longest and is not called any of names, to fill a seat in a
+	// lobby someone left
+	bool PopOldest(MatchCommand& intro, RakNet::TimeMS now, const std::vector<std::string>& names);
+
+	unsigned int GetReadyCount() const;
+	size_t GetQueuedCount() const;
+	// Milliseconds until the oldest ready player leaves their bucket, -1 if no one is waiting on one
+	int GetDelay(RakNet::TimeMS now) const;
+	// Queue sizes and how long matched players waited
+	void Print() const;
+
+	// Upper bounds of the ping buckets in milliseconds, the last takes everything slower or unmeasured
+	static const unsigned int PING_BUCKET_COUNT = 4;
+	static int PING_BUCKET_LIMITS_MS[PING_BUCKET_COUNT - 1];
+	static bool IS_PING_BUCKETED;
+	static unsigned int MAX_BUCKET_WAIT_MS;
+
+private:
+	// Players who gave up on their ping bucket
+	static const unsigned int SHARED_BUCKET = PING_BUCKET_COUNT;
+	// Groups from whoever has waited longest, whichever bucket they are in
+	static const unsigned int ANY_BUCKET = PING_BUCKET_COUNT + 1;
+
+	struct Ticket
+	{
+		MatchCommand intro;
+		std::string name;
+		bool isReady;
+		unsigned char bucket;
+		// Bumped each time the player readies, so queue entries from an earlier readying are skipped
+		unsigned int sequence;
+		RakNet::TimeMS readySince;
+	};
+
+	struct Entry
+	{
+		uint64_t guid;
+		unsigned int sequence;
+	};
+
+	unsigned char GetBucket(int ping) const;
+	void Push(Ticket& ticket, unsigned char bucket);
+	// Drops entries whose player unreadied or left, returns nullptr if the bucket has no one ready
+	Ticket* Front(unsigned char bucket);
+	const Ticket* Front(unsigned char bucket) const;
+	void Pop(unsigned char bucket);
+	// The oldest ready player in the bucket not called any of names, nullptr if there is none
+	Ticket* Find(unsigned char bucket, const std::vector<std::string>& names);
+	// The same across every bucket, those who gave up on theirs first
+	Ticket* FindOldest(const std::vector<std::string>& names);
+	// Appends groupSize players of distinct names from the bucket or ANY_BUCKET, or nothing if there
+	// are not that many
+	bool TakeGroup(unsigned char bucket, RakNet::TimeMS now, unsigned int groupSize, std::vector<MatchCommand>& intros);
+	// Forgets the player and hands back their intro
+	MatchCommand Take(Ticket& ticket, RakNet::TimeMS now);
+
+	std::unordered_map<uint64_t, Ticket> tickets;
+	std::deque<Entry> buckets[PING_BUCKET_COUNT + 1];
+	unsigned int readyCounts[PING_BUCKET_COUNT + 1];
+	unsigned int readyCount;
+	unsigned int nextSequence;
+	// Scratch for TakeGroup
+	std::vector<Ticket*> group;
+	std::vector<std::string> groupNames;
+	// From readying to being handed to a match, in milliseconds
+	Histogram waits;
+};
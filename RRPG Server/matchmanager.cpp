@@ -0,0 +1,672 @@
+#include "matchmanager.h"
+#include "log.h"
+#include "sessionrecording.h"
+
+#include "GetTime.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace
+{
+	// Turn deadlines are tens of seconds, a tenth of a second either way does not matter
+	const unsigned int TURN_TIMER_TICK_MS = 100;
+	const unsigned int CHAT_TIMER_TICK_MS = 10;
+}
+
+MatchManager::MatchManager(RakNet::RakPeerInterface* rpi, PacketPump& pump)
+	: rpi(rpi), pump(pump), workerPool(*this), nextMatchID(1), recorder(nullptr), isReplaying(false),
+	matchmakingTime(RakNet::GetTimeMS()), turnTimers(RakNet::GetTimeMS(), TURN_TIMER_TICK_MS),
+	chatTimers(RakNet::GetTimeMS(), CHAT_TIMER_TICK_MS)
+{
+	std::random_device rd;
+	seed = ((uint64_t)rd() << 32) | rd();
+}
+
+void MatchManager::StartWorkers(unsigned int workerCount)
+{
+	Log::Write(LOG_MATCH, LOG_INFO, "Match seed %llu", (unsigned long long)seed);
+	workerPool.Start(workerCount);
+}
+
+void MatchManager::StopWorkers()
+{
+	workerPool.Stop();
+}
+
+void MatchManager::ReleasePeer()
+{
+	openMatches.clear();
+	playerMatches.clear();
+	matches.clear();
+	rpi = nullptr;
+}
+
+void MatchManager::SetSeed(uint64_t seed)
+{
+	this->seed = seed;
+}
+
+uint64_t MatchManager::GetSeed() const
+{
+	return seed;
+}
+
+void MatchManager::SetRecorder(SessionRecorder* recorder)
+{
+	this->recorder = recorder;
+}
+
+void MatchManager::SetReplaying(bool isReplaying)
+{
+	this->isReplaying = isReplaying;
+}
+
+bool MatchManager::Matchmake(const MatchCommand& command, RakNet::TimeMS now, int ping)
+{
+	// Whoever reconnected before the server noticed the drop can still be bound under the same GUID
+	if (command.type == RRPG_ID::C_RESUME && !matchmaker.IsQueued(command.guid))
+	{
+		Resume(command);
+		return true;
+	}
+
+	if (GetMatch(command.guid) != nullptr)
+		return false;
+
+	MatchCommand intro;
+	switch (command.type)
+	{
+	case RRPG_ID::C_INTRO:
+		// A second intro while queued is dropped like a malformed one
+		if (matchmaker.Add(command, now, ping))
+			IssueResumeToken(command);
+		else
+			rpi->DeallocatePacket(command.packet);
+		return true;
+	case RRPG_ID::C_READY:
+	case RRPG_ID::C_UNREADY:
+		if (!matchmaker.IsQueued(command.guid))
+			return false;
+
+		matchmaker.SetReady(command.guid, command.type == RRPG_ID::C_READY, now, ping);
+		break;
+	case ID_DISCONNECTION_NOTIFICATION:
+	case ID_CONNECTION_LOST:
+		if (!matchmaker.Remove(command.guid, intro))
+			return false;
+
+		RevokeResumeToken(command.guid);
+		chatLimiter.Remove(command.guid.g);
+		rpi->DeallocatePacket(intro.packet);
+		break;
+	case RRPG_ID::C_PLAYER_LIST_REQUEST:
+	case RRPG_ID::C_CHAT:
+	{
+		if (!matchmaker.IsQueued(command.guid))
+			return false;
+
+		// There is no lobby to list or chat to yet, but the player should hear why
+		char reply[64];
+		if (command.type == RRPG_ID::C_PLAYER_LIST_REQUEST)
+			snprintf(reply, sizeof(reply), "[Server] Waiting for a match, %u queued.", (unsigned int)matchmaker.GetQueuedCount());
+		else if (AllowChat(command, now))
+			snprintf(reply, sizeof(reply), "[Server] Chat opens once you are in a match.");
+		else
+			break;
+
+		RakNet::BitStream bs;
+		ChatMessage::Write(&bs, reply);
+		Send(command.address, &bs);
+		break;
+	}
+	default:
+		// Anything else has no lobby to go to yet
+		if (!matchmaker.IsQueued(command.guid))
+			return false;
+		break;
+	}
+
+	rpi->DeallocatePacket(command.packet);
+	return true;
+}
+
+void MatchManager::FormMatches(RakNet::TimeMS now)
+{
+	matchmakingTime = now;
+	RequeueReturnedPlayers();
+
+	MatchCommand intro;
+	auto open = openMatches.begin();
+	while (open != openMatches.end() && matchmaker.GetReadyCount() > 0)
+	{
+		// Seat may drop the match from openMatches, so step past it first
+		unsigned int id = *open++;
+		auto it = matches.find(id);
+		if (it == matches.end() || !IsOpen(it->second))
+		{
+			openMatches.erase(id);
+			continue;
+		}
+
+		// A full mailbox puts the player straight back, so the lobby waits for the next loop
+		while (IsOpen(it->second) && matchmaker.PopOldest(intro, now, it->second.seatedNames))
+			if (!Seat(it->second, intro, now))
+				break;
+	}
+
+	matchmaker.FormGroups(now, Match::EXPECTED_PLAYERS, formedGroups);
+	for (size_t first = 0; first < formedGroups.size(); first += Match::EXPECTED_PLAYERS)
+	{
+		ManagedMatch& managed = matches[CreateMatch().GetID()];
+		for (size_t i = first; i < first + Match::EXPECTED_PLAYERS; i++)
+			Seat(managed, formedGroups[i], now);
+	}
+
+	formedGroups.clear();
+}
+
+void MatchManager::PrintMatchmaking() const
+{
+	matchmaker.Print();
+}
+
+Match* MatchManager::GetMatch(RakNet::RakNetGUID id)
+{
+	auto it = playerMatches.find(id.g);
+	if (it == playerMatches.end())
+		return nullptr;
+
+	return it->second;
+}
+
+void MatchManager::RemovePlayer(RakNet::RakNetGUID id)
+{
+	Match* match = GetMatch(id);
+	if (match == nullptr)
+		return;
+
+	Unseat(id, *match);
+	RevokeResumeToken(id);
+	chatLimiter.Remove(id.g);
+}
+
+void MatchManager::OnConnectionLost(RakNet::RakNetGUID id)
+{
+	// If the game starts before the match hears of it, the player is left to time out instead
+	Match* match = GetMatch(id);
+	if (match != nullptr && match->GetGameState() == GS_PENDING)
+		RemovePlayer(id);
+}
+
+bool MatchManager::AllowChat(const MatchCommand& command, RakNet::TimeMS now)
+{
+	bool isFirstRefusal;
+	if (chatLimiter.Allow(command.guid.g, now, isFirstRefusal))
+		return true;
+
+	if (isFirstRefusal)
+	{
+		RakNet::BitStream bs;
+		ChatMessage::Write(&bs, "[Server] You are sending messages too quickly.");
+		Send(command.address, &bs);
+	}
+	return false;
+}
+
+bool MatchManager::Post(Match& match, const MatchCommand& command)
+{
+	bool wasIdle;
+	if (!match.Post(command, wasIdle))
+		return false;
+
+	if (wasIdle)
+		workerPool.Schedule(&match);
+	return true;
+}
+
+void MatchManager::CollectFinishedMatches()
+{
+	std::vector<unsigned int> finished;
+	{
+		std::lock_guard<std::mutex> guard(finishedMatches_mutex);
+		finished.swap(finishedMatches);
+	}
+
+	for (unsigned int id : finished)
+	{
+		auto it = matches.find(id);
+		if (it == matches.end())
+			continue;
+
+		// Packets posted after the worker reported in are still being drained, try again next loop
+		if (!it->second.match->IsIdle())
+		{
+			OnMatchFinished(id);
+			continue;
+		}
+
+		DestroyMatch(*it->second.match);
+	}
+}
+
+void MatchManager::OnMatchFinished(unsigned int id)
+{
+	if (isReplaying)
+		return;
+
+	std::lock_guard<std::mutex> guard(finishedMatches_mutex);
+	finishedMatches.push_back(id);
+}
+
+void MatchManager::ReturnToMatchmaking(unsigned int id, const MatchCommand& intro)
+{
+	ReturnedPlayer returned{ id, intro };
+	returned.intro.packet = rpi->AllocatePacket(intro.packet->length);
+	memcpy(returned.intro.packet->data, intro.packet->data, intro.packet->length);
+	returned.intro.packet->guid = intro.packet->guid;
+	returned.intro.packet->systemAddress = intro.packet->systemAddress;
+	{
+		std::lock_guard<std::mutex> guard(returnedPlayers_mutex);
+		returnedPlayers.push_back(returned);
+	}
+
+	pump.Wake();
+}
+
+void MatchManager::ArmTurnTimer(unsigned int id, unsigned int turn, RakNet::TimeMS deadline)
+{
+	ArmTimer(TimerRequest{ id, MC_TURN_TIMEOUT, turn, deadline });
+}
+
+void MatchManager::ArmChatFlush(unsigned int id, RakNet::TimeMS deadline)
+{
+	ArmTimer(TimerRequest{ id, MC_CHAT_FLUSH, 0, deadline });
+}
+
+void MatchManager::UpdateTimers(RakNet::TimeMS now)
+{
+	{
+		// Both buffers keep their capacity, so workers arming timers do not allocate once warmed up
+		std::lock_guard<std::mutex> guard(timerRequests_mutex);
+		armedTimers.swap(timerRequests);
+	}
+
+	turnTimers.Advance(now, expiredTimers);
+	PostExpiredTimers(turnTimers, MC_TURN_TIMEOUT);
+	chatTimers.Advance(now, expiredTimers);
+	PostExpiredTimers(chatTimers, MC_CHAT_FLUSH);
+
+	// After the expired ones, so a deadline armed since then is not lost with its predecessor
+	for (const TimerRequest& request : armedTimers)
+	{
+		auto it = matches.find(request.id);
+		if (it == matches.end())
+			continue;
+
+		int delay = (int)(request.deadline - now);
+		uint64_t payload = ((uint64_t)request.id << 32) | request.turn;
+		if (request.type == MC_CHAT_FLUSH)
+		{
+			// The match arms one flush at a time, so there is nothing to replace
+			chatTimers.Add(delay > 0 ? delay : 0, payload);
+			continue;
+		}
+
+		turnTimers.Cancel(it->second.turnTimer);
+		it->second.turnTimer = turnTimers.Add(delay > 0 ? delay : 0, payload);
+	}
+
+	armedTimers.clear();
+}
+
+int MatchManager::GetDelay(RakNet::TimeMS now) const
+{
+	int delays[] = { turnTimers.GetDelay(now), chatTimers.GetDelay(now), matchmaker.GetDelay(now) };
+	int delay = -1;
+	for (int candidate : delays)
+		if (candidate >= 0 && (delay < 0 || candidate < delay))
+			delay = candidate;
+
+	return delay;
+}
+
+bool MatchManager::IsIdle() const
+{
+	for (const auto& managed : matches)
+		if (!managed.second.match->IsIdle())
+			return false;
+
+	return true;
+}
+
+void MatchManager::ReplayTimer(unsigned int id, unsigned char type, unsigned int turn)
+{
+	auto it = matches.find(id);
+	if (it == matches.end())
+		return;
+
+	MatchCommand command;
+	if (type == MC_TURN_TIMEOUT)
+		MakeTurnTimeoutCommand(turn, command);
+	else
+		MakeChatFlushCommand(command);
+
+	while (!Post(*it->second.match, command))
+		std::this_thread::yield();
+}
+
+void MatchManager::ReplayTeardown(unsigned int id)
+{
+	auto it = matches.find(id);
+	if (it == matches.end())
+		return;
+
+	while (!it->second.match->IsIdle())
+		std::this_thread::yield();
+
+	DestroyMatch(*it->second.match);
+}
+
+void MatchManager::ReplayRequeue(unsigned int id, RakNet::RakNetGUID guid)
+{
+	// The match hands the player back while handling their intro, which is done once it is idle
+	auto it = matches.find(id);
+	if (it != matches.end())
+	{
+		while (!it->second.match->IsIdle())
+			std::this_thread::yield();
+	}
+
+	ReturnedPlayer found;
+	bool isFound = false;
+	{
+		std::lock_guard<std::mutex> guard(returnedPlayers_mutex);
+		for (auto returned = returnedPlayers.begin(); returned != returnedPlayers.end(); ++returned)
+		{
+			if (returned->id == id && returned->intro.guid == guid)
+			{
+				found = *returned;
+				returnedPlayers.erase(returned);
+				isFound = true;
+				break;
+			}
+		}
+	}
+
+	if (!isFound)
+	{
+		Log::Write(LOG_MATCH, LOG_WARNING, "Match %u never handed back the player the recording requeues", id);
+		return;
+	}
+
+	Requeue(found);
+}
+
+size_t MatchManager::GetMatchCount() const
+{
+	return matches.size();
+}
+
+size_t MatchManager::GetPlayerCount() const
+{
+	return playerMatches.size();
+}
+
+Match& MatchManager::CreateMatch()
+{
+	unsigned int id = nextMatchID++;
+	uint64_t matchSeed = MatchRandom::Mix(seed + id);
+	Match* match = new Match(id, matchSeed, rpi, *this);
+	matches[id] = ManagedMatch{ std::unique_ptr<Match>(match), 0, NO_TIMER, {}, {} };
+	openMatches.insert(id);
+	Log::Write(LOG_MATCH, LOG_INFO, "Match %u created with seed %llu (%u active)", id, (unsigned long long)matchSeed, (unsigned int)matches.size());
+	return *match;
+}
+
+void MatchManager::ArmTimer(const TimerRequest& request)
+{
+	if (isReplaying)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(timerRequests_mutex);
+		timerRequests.push_back(request);
+	}
+
+	pump.Wake();
+}
+
+void MatchManager::PostExpiredTimers(TimerWheel& timers, unsigned char type)
+{
+	for (uint64_t payload : expiredTimers)
+	{
+		unsigned int id = (unsigned int)(payload >> 32);
+		unsigned int turn = (unsigned int)payload;
+		auto it = matches.find(id);
+		if (it == matches.end())
+			continue;
+
+		MatchCommand command;
+		if (type == MC_TURN_TIMEOUT)
+		{
+			it->second.turnTimer = NO_TIMER;
+			MakeTurnTimeoutCommand(turn, command);
+		}
+		else
+			MakeChatFlushCommand(command);
+
+		if (!Post(*it->second.match, command))
+		{
+			// Try again on the next tick rather than leave the match stalled
+			Log::Write(LOG_MATCH, LOG_WARNING, "Match %u mailbox is full, retrying %s", id, GetCommandName(type));
+			TimerHandle handle = timers.Add(0, payload);
+			if (type == MC_TURN_TIMEOUT)
+				it->second.turnTimer = handle;
+			continue;
+		}
+
+		if (recorder != nullptr)
+			recorder->RecordTimer(id, type, turn);
+	}
+
+	expiredTimers.clear();
+}
+
+void MatchManager::RequeueReturnedPlayers()
+{
+	if (isReplaying)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(returnedPlayers_mutex);
+		requeuedPlayers.swap(returnedPlayers);
+	}
+
+	for (const ReturnedPlayer& returned : requeuedPlayers)
+		Requeue(returned);
+
+	requeuedPlayers.clear();
+}
+
+void MatchManager::Requeue(const ReturnedPlayer& returned)
+{
+	// Whoever left in the meantime has no seat to give back
+	Match* match = GetMatch(returned.intro.guid);
+	if (match == nullptr || match->GetID() != returned.id)
+	{
+		rpi->DeallocatePacket(returned.intro.packet);
+		return;
+	}
+
+	Unseat(returned.intro.guid, *match);
+	if (!matchmaker.Requeue(returned.intro, matchmakingTime))
+	{
+		rpi->DeallocatePacket(returned.intro.packet);
+		return;
+	}
+
+	if (recorder != nullptr)
+		recorder->RecordRequeue(returned.id, returned.intro.guid);
+	Log::Write(LOG_MATCH, LOG_INFO, "Match %u handed %s back to matchmaking", returned.id, returned.intro.address.ToString(true));
+}
+
+void MatchManager::Unseat(RakNet::RakNetGUID id, Match& match)
+{
+	playerMatches.erase(id.g);
+	auto it = matches.find(match.GetID());
+	it->second.seats--;
+	std::vector<uint64_t>& guids = it->second.seatedGUIDs;
+	auto seated = std::find(guids.begin(), guids.end(), id.g);
+	if (seated != guids.end())
+	{
+		it->second.seatedNames.erase(it->second.seatedNames.begin() + (seated - guids.begin()));
+		guids.erase(seated);
+	}
+	if (IsOpen(it->second))
+		openMatches.insert(it->first);
+}
+
+void MatchManager::Resume(const MatchCommand& command)
+{
+	auto token = resumeTokens.find(command.resumeToken);
+	Match* match = token == resumeTokens.end() ? nullptr : GetMatch(RakNet::RakNetGUID(token->second));
+	GameState state = match == nullptr ? GS_GAME_OVER : match->GetGameState();
+	Match* current = GetMatch(command.guid);
+	MatchCommand resume = command;
+	if ((state == GS_CHARACTER_SELECT || state == GS_MAIN) && (current == nullptr || current == match))
+	{
+		resume.resumedGUID = RakNet::RakNetGUID(token->second);
+		if (Post(*match, resume))
+		{
+			// Whatever the old connection still sends is dropped from here on
+			playerMatches.erase(resume.resumedGUID.g);
+			playerMatches.emplace(command.guid.g, match);
+			playerTokens.erase(resume.resumedGUID.g);
+			playerTokens.emplace(command.guid.g, token->first);
+			chatLimiter.Remove(resume.resumedGUID.g);
+			token->second = command.guid.g;
+			return;
+		}
+
+		Log::Write(LOG_MATCH, LOG_WARNING, "Match %u mailbox is full, refusing resume from %s", match->GetID(), command.address.ToString(true));
+	}
+
+	rpi->DeallocatePacket(command.packet);
+	RakNet::BitStream bs;
+	ResumeRejectedMessage::Write(&bs);
+	Send(command.address, &bs);
+}
+
+void MatchManager::IssueResumeToken(const MatchCommand& intro)
+{
+	uint64_t token;
+	do
+		token = ((uint64_t)tokenSource() << 32) | tokenSource();
+	while (token == 0 || resumeTokens.count(token) != 0);
+
+	resumeTokens.emplace(token, intro.guid.g);
+	playerTokens.emplace(intro.guid.g, token);
+
+	RakNet::BitStream bs;
+	IntroAcceptedMessage::Write(&bs, token);
+	Send(intro.address, &bs);
+}
+
+void MatchManager::RevokeResumeToken(RakNet::RakNetGUID id)
+{
+	auto it = playerTokens.find(id.g);
+	if (it == playerTokens.end())
+		return;
+
+	resumeTokens.erase(it->second);
+	playerTokens.erase(it);
+}
+
+void MatchManager::Send(const RakNet::SystemAddress& address, const RakNet::BitStream* bs)
+{
+	SendWithPolicy(rpi, bs, address);
+}
+
+bool MatchManager::Seat(ManagedMatch& managed, const MatchCommand& intro, RakNet::TimeMS now)
+{
+	// Posted before anything is bound, so a full mailbox leaves no seat behind for a player the match
+	// never heard of. One command both seats and readies them, so it cannot be half done
+	Match& match = *managed.match;
+	// Read before posting, after that the packet belongs to the match. Matchmaking already read the
+	// intro, so it is well formed
+	char name[NAME_BUFFER_SIZE];
+	bool isReady;
+	IntroRequest::Read(intro.packet, name, isReady);
+	bool isPosted = Post(match, intro);
+	// A replay waits for the match instead, as it does for packets
+	while (!isPosted && isReplaying)
+	{
+		std::this_thread::yield();
+		isPosted = Post(match, intro);
+	}
+
+	if (!isPosted)
+	{
+		Log::Write(LOG_MATCH, LOG_WARNING, "Match %u mailbox is full, requeueing %s", match.GetID(), intro.address.ToString(true));
+		if (!matchmaker.Requeue(intro, now))
+			rpi->DeallocatePacket(intro.packet);
+		return false;
+	}
+
+	managed.seats++;
+	if (!IsOpen(managed))
+		openMatches.erase(match.GetID());
+	playerMatches.emplace(intro.guid.g, &match);
+	managed.seatedGUIDs.push_back(intro.guid.g);
+	managed.seatedNames.push_back(name);
+	return true;
+}
+
+void MatchManager::DestroyMatch(Match& match)
+{
+	// The match is idle, so whoever it handed back is in the list by now and still bound to it
+	RequeueReturnedPlayers();
+
+	unsigned int id = match.GetID();
+	if (isReplaying)
+	{
+		// Its requeues were replayed before its teardown, whoever else it handed back had left
+		std::lock_guard<std::mutex> guard(returnedPlayers_mutex);
+		for (auto returned = returnedPlayers.begin(); returned != returnedPlayers.end();)
+		{
+			if (returned->id != id)
+			{
+				++returned;
+				continue;
+			}
+
+			rpi->DeallocatePacket(returned->intro.packet);
+			returned = returnedPlayers.erase(returned);
+		}
+	}
+
+	for (const RakNet::RakNetGUID& guid : match.GetPlayerGUIDs())
+	{
+		playerMatches.erase(guid.g);
+		RevokeResumeToken(guid);
+		chatLimiter.Remove(guid.g);
+	}
+
+	if (recorder != nullptr)
+		recorder->RecordTeardown(id);
+
+	match.Close();
+	auto it = matches.find(id);
+	turnTimers.Cancel(it->second.turnTimer);
+	openMatches.erase(id);
+	matches.erase(it);
+	Log::Write(LOG_MATCH, LOG_INFO, "Match %u torn down (%u active)", id, (unsigned int)matches.size());
+}
+
+bool MatchManager::IsOpen(const ManagedMatch& managed) const
+{
+	return managed.seats < Match::EXPECTED_PLAYERS && managed.match->GetGameState() == GS_PENDING;
+}
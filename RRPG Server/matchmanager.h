@@ -0,0 +1,180 @@
+#pragma once
+#include "chatlimiter.h"
+#include "match.h"
+#include "matchmaker.h"
+#include "timerwheel.h"
+#include "workerpool.h"
+#include "RRPG_PacketPump.h"
+
+#include "RakPeerInterface.h"
+#include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+class SessionRecorder;
+
+// Owned by the packet thread: only it binds players to matches, posts packets and tears matches down.
+// The matches themselves run on the worker pool.
+class MatchManager
+{
+public:
+	// Workers arming a timer wake the packet thread through pump, so it never sleeps past the deadline
+	MatchManager(RakNet::RakPeerInterface* rpi, PacketPump& pump);
+
+	void StartWorkers(unsigned int workerCount);
+	void StopWorkers();
+	// Drops every match and forgets the peer. After StopWorkers and before the peer is destroyed
+	void ReleasePeer();
+	// Match n is seeded from seed and n alone, so the same seed and join order replays the same games.
+	// Drawn from std::random_device unless set before the first match is created
+	void SetSeed(uint64_t seed);
+	uint64_t GetSeed() const;
+	// Timers firing and matches being torn down depend on the clock and on how far the workers got,
+	// so they are written down as they happen
+	void SetRecorder(SessionRecorder* recorder);
+	// While replaying no timers are armed and finished matches are left alone, the recording says
+	// when to fire and tear down instead
+	void SetReplaying(bool isReplaying);
+
+	// Takes the commands of players who are not in a match yet: intros queue the player and are
+	// answered with a resume token, resumes hand the player back their seat, ready flags and disconnects
+	// update the queue, list requests and chat are answered with why there is no lobby yet. Returns
+	// false for players in a match or unknown to
+	// matchmaking, the caller still owns the packet then. ping is what the player is bucketed by for
+	// intros and ready flags, passed in so a replay buckets them as the recording did
+	bool Matchmake(const MatchCommand& command, RakNet::TimeMS now, int ping);
+	// Tops up lobbies someone left, then gives every full group matchmaking can make a match of its own
+	void FormMatches(RakNet::TimeMS now);
+	void PrintMatchmaking() const;
+	Match* GetMatch(RakNet::RakNetGUID id);
+	// Unbinds the player and frees their seat, the match still has to be told through Post
+	void RemovePlayer(RakNet::RakNetGUID id);
+	// A dropped connection only frees the seat in a lobby, mid-game it is kept for the player to resume
+	void OnConnectionLost(RakNet::RakNetGUID id);
+	// Charges the chat line to the player's bucket. Refused lines are never posted, so a flood cannot
+	// crowd turns out of the match's mailbox; the player is told the first time
+	bool AllowChat(const MatchCommand& command, RakNet::TimeMS now);
+	// Hands the command to the match, scheduling it on a worker if it was idle.
+	// Returns false if the match's mailbox is full, the caller still owns the packet then
+	bool Post(Match& match, const MatchCommand& command);
+	// Tears down matches the workers reported as over or abandoned
+	void CollectFinishedMatches();
+	// Called from a worker thread
+	void OnMatchFinished(unsigned int id);
+	// Called from a worker thread: the match's turn must be answered by deadline or the match is sent
+	// MC_TURN_TIMEOUT. Replaces whatever deadline the match had before
+	void ArmTurnTimer(unsigned int id, unsigned int turn, RakNet::TimeMS deadline);
+	// Called from a worker thread: the match could not seat the player it was handed, so they are
+	// unbound and queued again. Copies the intro's packet, the match still frees its own
+	void ReturnToMatchmaking(unsigned int id, const MatchCommand& intro);
+	// Called from a worker thread: the match is sent MC_CHAT_FLUSH once deadline passes
+	void ArmChatFlush(unsigned int id, RakNet::TimeMS deadline);
+	// Takes in newly armed deadlines and posts the ones that have passed
+	void UpdateTimers(RakNet::TimeMS now);
+	// How long the packet thread may sleep before a deadline passes or a queued player gives up on
+	// their ping bucket, -1 if neither is pending
+	int GetDelay(RakNet::TimeMS now) const;
+
+	// True once every match has handled everything posted to it
+	bool IsIdle() const;
+	// Replays a recorded firing, waiting for room in the match's mailbox
+	void ReplayTimer(unsigned int id, unsigned char type, unsigned int turn);
+	// Replays a recorded teardown once the match has handled everything posted before it
+	void ReplayTeardown(unsigned int id);
+	// Replays a recorded requeue once the match has handed the player back
+	void ReplayRequeue(unsigned int id, RakNet::RakNetGUID guid);
+	size_t GetMatchCount() const;
+	size_t GetPlayerCount() const;
+
+private:
+	struct ManagedMatch
+	{
+		std::unique_ptr<Match> match;
+		unsigned int seats;
+		TimerHandle turnTimer;
+		// Who was seated under which name, so a lobby is not topped up with a second of a name
+		std::vector<uint64_t> seatedGUIDs;
+		std::vector<std::string> seatedNames;
+	};
+
+	struct ReturnedPlayer
+	{
+		unsigned int id;
+		MatchCommand intro;
+	};
+
+	struct TimerRequest
+	{
+		unsigned int id;
+		// MC_TURN_TIMEOUT or MC_CHAT_FLUSH
+		unsigned char type;
+		unsigned int turn;
+		RakNet::TimeMS deadline;
+	};
+
+	Match& CreateMatch();
+	void ArmTimer(const TimerRequest& request);
+	// Posts what fired, rearming anything whose match had no room for it yet
+	void PostExpiredTimers(TimerWheel& timers, unsigned char type);
+	// Queues the players matches handed back. Left to the recording while replaying, since when they
+	// come back depends on how far the workers got
+	void RequeueReturnedPlayers();
+	// Queues the player again as long as they are still bound to the match that handed them back,
+	// otherwise frees the intro
+	void Requeue(const ReturnedPlayer& returned);
+	// Unbinds the player and frees their seat, reopening the lobby
+	void Unseat(RakNet::RakNetGUID id, Match& match);
+	// Hands the match the intro of a player matchmaking picked, which seats them ready, and binds them
+	// to it. If the mailbox is full the player is queued again instead and false is returned
+	bool Seat(ManagedMatch& managed, const MatchCommand& intro, RakNet::TimeMS now);
+	// Rebinds the player to their seat under the new connection's GUID and has the match send them a snapshot
+	void Resume(const MatchCommand& command);
+	void IssueResumeToken(const MatchCommand& intro);
+	void RevokeResumeToken(RakNet::RakNetGUID id);
+	// For a player who has no match to send it for them
+	void Send(const RakNet::SystemAddress& address, const RakNet::BitStream* bs);
+	void DestroyMatch(Match& match);
+	bool IsOpen(const ManagedMatch& managed) const;
+
+private:
+	RakNet::RakPeerInterface* rpi;
+	PacketPump& pump;
+	WorkerPool workerPool;
+	unsigned int nextMatchID;
+	uint64_t seed;
+	SessionRecorder* recorder;
+	bool isReplaying;
+	// What FormMatches last ran at, recorded while replaying, so players handed back between loops
+	// are queued by the same clock as everyone else
+	RakNet::TimeMS matchmakingTime;
+	std::map<unsigned int, ManagedMatch> matches;
+	std::set<unsigned int> openMatches;
+	std::unordered_map<uint64_t, Match*> playerMatches;
+	Matchmaker matchmaker;
+	std::vector<MatchCommand> formedGroups;
+	std::mutex finishedMatches_mutex;
+	std::vector<unsigned int> finishedMatches;
+	std::mutex returnedPlayers_mutex;
+	std::vector<ReturnedPlayer> returnedPlayers;
+	// Swapped with returnedPlayers, owned by the packet thread
+	std::vector<ReturnedPlayer> requeuedPlayers;
+	TimerWheel turnTimers;
+	// Chat windows are tens of milliseconds, far finer than turns need
+	TimerWheel chatTimers;
+	std::mutex timerRequests_mutex;
+	std::vector<TimerRequest> timerRequests;
+	// Swapped with timerRequests each update, owned by the packet thread
+	std::vector<TimerRequest> armedTimers;
+	std::vector<uint64_t> expiredTimers;
+	ChatLimiter chatLimiter;
+	// Tokens to the GUID of the player they resume and back, kept until the player leaves for good
+	std::unordered_map<uint64_t, uint64_t> resumeTokens;
+	std::unordered_map<uint64_t, uint64_t> playerTokens;
+	// Tokens must not be guessable from the ones other players were given
+	std::random_device tokenSource;
+};
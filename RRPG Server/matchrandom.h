@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 (XSH RR): 16 bytes of state and a multiply per draw. Each match owns one, so workers never
+// share a generator, and a match seeded the same way rolls the same numbers.
+class MatchRandom
+{
+public:
+	explicit MatchRandom(uint64_t seed)
+		: state(0), increment(INCREMENT)
+	{
+		Next();
+		state += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		uint64_t old = state;
+		state = old * MULTIPLIER + increment;
+		uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rotation = (uint32_t)(old >> 59);
+		return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31));
+	}
+
+	// Uniform in [min, max]
+	int GetInteger(int min, int max)
+	{
+		uint32_t range = (uint32_t)(max - min) + 1;
+		// Rejects the few low draws that would bias the modulo
+		uint32_t threshold = (0u - range) % range;
+		uint32_t value;
+		do
+			value = Next();
+		while (value < threshold);
+
+		return min + (int)(value % range);
+	}
+
+	// Spreads consecutive inputs, such as a base seed plus a match ID, into unrelated seeds (SplitMix64)
+	static uint64_t Mix(uint64_t value)
+	{
+		value += 0x9E3779B97F4A7C15ull;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+private:
+	static const uint64_t MULTIPLIER = 6364136223846793005ull;
+	static const uint64_t INCREMENT = 1442695040888963407ull;
+
+	uint64_t state;
+	uint64_t increment;
+};
@@ -0,0 +1,102 @@
+#include "messagestats.h"
+#include "log.h"
+#include "matchcommand.h"
+#include "RRPG_Histogram.h"
+#include "RRPG_MessageIdentifiers.h"
+
+#include <atomic>
+#include <cstdio>
+
+namespace
+{
+	struct MessageLatency
+	{
+		ConcurrentHistogram wait;
+		ConcurrentHistogram handle;
+	};
+
+	// Created the first time a type is seen so only the few types in use cost any memory
+	std::atomic<MessageLatency*> latencies[256];
+	std::atomic<unsigned long long> sentCounts[256];
+	std::atomic<unsigned long long> sentBytes[256];
+
+	MessageLatency& GetLatency(unsigned char type)
+	{
+		MessageLatency* latency = latencies[type].load(std::memory_order_acquire);
+		if (latency != nullptr)
+			return *latency;
+
+		MessageLatency* created = new MessageLatency();
+		if (latencies[type].compare_exchange_strong(latency, created, std::memory_order_acq_rel))
+			return *created;
+
+		delete created;
+		return *latency;
+	}
+
+	void GetName(unsigned char type, char* name, size_t size)
+	{
+		const char* knownName = GetCommandName(type);
+		if (knownName != nullptr)
+			snprintf(name, size, "%s", knownName);
+		else
+			snprintf(name, size, "%u", type);
+	}
+}
+
+void MessageStats::Record(unsigned char type, unsigned int waitUs, unsigned int handleUs)
+{
+	MessageLatency& latency = GetLatency(type);
+	latency.wait.Record(waitUs);
+	latency.handle.Record(handleUs);
+}
+
+void MessageStats::RecordSent(unsigned char type, unsigned int bytes)
+{
+	sentCounts[type].fetch_add(1, std::memory_order_relaxed);
+	sentBytes[type].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+unsigned long long MessageStats::GetSentBytes()
+{
+	unsigned long long total = 0;
+	for (const std::atomic<unsigned long long>& bytes : sentBytes)
+		total += bytes.load(std::memory_order_relaxed);
+
+	return total;
+}
+
+void MessageStats::Print()
+{
+	Log::Write(LOG_SERVER, LOG_INFO, "%-30s %10s %28s %28s", "message", "count", "wait p50/p99/p999/max us", "handle p50/p99/p999/max us");
+	for (unsigned int type = 0; type < 256; type++)
+	{
+		MessageLatency* latency = latencies[type].load(std::memory_order_acquire);
+		if (latency == nullptr)
+			continue;
+
+		// Copied out so the percentiles are read from counts that are no longer moving
+		Histogram wait, handle;
+		wait.Merge(latency->wait);
+		handle.Merge(latency->handle);
+
+		char name[32];
+		GetName((unsigned char)type, name, sizeof(name));
+		Log::Write(LOG_SERVER, LOG_INFO, "%-30s %10llu %6u/%6u/%6u/%6u %6u/%6u/%6u/%6u", name, wait.GetCount(),
+			wait.GetPercentile(50.0), wait.GetPercentile(99.0), wait.GetPercentile(99.9), wait.GetMax(),
+			handle.GetPercentile(50.0), handle.GetPercentile(99.0), handle.GetPercentile(99.9), handle.GetMax());
+	}
+
+	Log::Write(LOG_SERVER, LOG_INFO, "%-30s %10s %14s %10s", "sent", "count", "bytes", "bytes each");
+	for (unsigned int type = 0; type < 256; type++)
+	{
+		unsigned long long count = sentCounts[type].load(std::memory_order_relaxed);
+		if (count == 0)
+			continue;
+
+		unsigned long long bytes = sentBytes[type].load(std::memory_order_relaxed);
+		char name[32];
+		GetName((unsigned char)type, name, sizeof(name));
+		Log::Write(LOG_SERVER, LOG_INFO, "%-30s %10llu %14llu %10.2f", name, count, bytes, (double)bytes / count);
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Per message type histograms of how long commands waited between Receive() on the packet thread
+// and their handler starting, and how long handling (including the replies it flushed) took.
+// Recording is lock-free from any worker; .latency on the server console logs them.
+// Also counts what matches send by message type, so a replay can report bytes per turn.
+class MessageStats
+{
+public:
+	static void Record(unsigned char type, unsigned int waitUs, unsigned int handleUs);
+	// Batched messages count their own bytes, the batch header and length prefixes count under S_BATCH
+	static void RecordSent(unsigned char type, unsigned int bytes);
+	static unsigned long long GetSentBytes();
+	static void Print();
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+
+// Bounded lock-free queue for many producers and one consumer, after Dmitry Vyukov's array queue.
+// Each cell carries a sequence number telling producers whether it is free and the consumer whether
+// it has been filled. Push fails rather than blocks when the queue is full.
+// The consumer side is not thread-safe; it may move between threads as long as only one pops at a time.
+template <typename T, unsigned int Capacity>
+class MpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MpscQueue capacity must be a power of two");
+
+public:
+	MpscQueue()
+		: enqueuePos(0), dequeuePos(0)
+	{
+		for (unsigned int i = 0; i < Capacity; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	bool Push(const T& value)
+	{
+		Cell* cell;
+		unsigned int pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[pos & (Capacity - 1)];
+			unsigned int sequence = cell->sequence.load(std::memory_order_acquire);
+			int diff = (int)(sequence - pos);
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+
+		cell->value = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& value)
+	{
+		Cell& cell = cells[dequeuePos & (Capacity - 1)];
+		unsigned int sequence = cell.sequence.load(std::memory_order_acquire);
+		if ((int)(sequence - (dequeuePos + 1)) < 0)
+			return false;
+
+		value = cell.value;
+		cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+		dequeuePos++;
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<unsigned int> sequence;
+		T value;
+	};
+
+	// Padding keeps producers and the consumer off each other's cache lines
+	// (alignas would make the owning Match over-aligned, which plain new does not honour before C++17)
+	Cell cells[Capacity];
+	char padding0[64];
+	std::atomic<unsigned int> enqueuePos;
+	char padding1[64];
+	unsigned int dequeuePos;
+};
@@ -0,0 +1,111 @@
+#include "outgoingbatch.h"
+#include "RRPG_MessageIdentifiers.h"
+#include "messagestats.h"
+
+namespace
+{
+	// Message id plus the first length prefix
+	const unsigned int BATCH_HEADER_BYTES = 1 + sizeof(unsigned short);
+}
+
+OutgoingBatch::OutgoingBatch(RakNet::RakPeerInterface* rpi)
+	: rpi(rpi)
+{
+}
+
+void OutgoingBatch::Queue(PlayerSlot slot, const RakNet::SystemAddress& address, const RakNet::BitStream* bs)
+{
+	Queue(slot, address, (const char*)bs->GetData(), bs->GetNumberOfBytesUsed());
+}
+
+void OutgoingBatch::Queue(PlayerSlot slot, const RakNet::SystemAddress& address, const char* data, unsigned int length)
+{
+	RakAssert(length <= 0xFFFF);
+	Batch& batch = GetRecipient(slot, address).batches[GetSendClass((unsigned char)data[0])];
+	if (batch.messageCount == 0)
+		batch.stream->Write((unsigned char)RRPG_ID::S_BATCH);
+
+	batch.stream->Write((unsigned short)length);
+	batch.stream->WriteAlignedBytes((const unsigned char*)data, length);
+	batch.messageCount++;
+	MessageStats::RecordSent((unsigned char)data[0], length);
+}
+
+void OutgoingBatch::Flush()
+{
+	for (PlayerSlot slot : pending)
+	{
+		Flush(recipients[slot]);
+		recipients[slot].isPending = false;
+	}
+
+	pending.clear();
+}
+
+void OutgoingBatch::Flush(Recipient& recipient)
+{
+	for (unsigned char sendClass = 0; sendClass < SEND_CLASS_COUNT; sendClass++)
+		Flush(recipient.address, recipient.batches[sendClass], (SendClass)sendClass);
+}
+
+void OutgoingBatch::Flush(const RakNet::SystemAddress& address, Batch& batch, SendClass sendClass)
+{
+	if (batch.messageCount == 0)
+		return;
+
+	RakNet::BitStream& bs = *batch.stream;
+	if (batch.messageCount == 1)
+	{
+		const char* message = (const char*)bs.GetData() + BATCH_HEADER_BYTES;
+		SendWithPolicy(rpi, message, bs.GetNumberOfBytesUsed() - BATCH_HEADER_BYTES, sendClass, address);
+	}
+	else
+	{
+		SendWithPolicy(rpi, (const char*)bs.GetData(), bs.GetNumberOfBytesUsed(), sendClass, address);
+		MessageStats::RecordSent(RRPG_ID::S_BATCH, 1 + batch.messageCount * sizeof(unsigned short));
+	}
+
+	bs.Reset();
+	batch.messageCount = 0;
+}
+
+OutgoingBatch::Recipient& OutgoingBatch::GetRecipient(PlayerSlot slot, const RakNet::SystemAddress& address)
+{
+	if (slot >= recipients.size())
+	{
+		size_t first = recipients.size();
+		recipients.resize(slot + 1);
+		for (size_t i = first; i < recipients.size(); i++)
+		{
+			for (Batch& batch : recipients[i].batches)
+			{
+				batch.stream.reset(new RakNet::BitStream());
+				batch.messageCount = 0;
+			}
+			recipients[i].isPending = false;
+		}
+	}
+
+	Recipient& recipient = recipients[slot];
+	// The slot changed hands since the last flush, don't mix two players' messages
+	if (!IsEmpty(recipient) && recipient.address != address)
+		Flush(recipient);
+
+	recipient.address = address;
+	if (!recipient.isPending)
+	{
+		recipient.isPending = true;
+		pending.push_back(slot);
+	}
+
+	return recipient;
+}
+
+bool OutgoingBatch::IsEmpty(const Recipient& recipient) const
+{
+	for (const Batch& batch : recipient.batches)
+		if (batch.messageCount != 0)
+			return false;
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_SendPolicy.h"
+
+#include "RakPeerInterface.h"
+#include "BitStream.h"
+#include <memory>
+#include <vector>
+
+// Collects everything a match sends while handling one command and flushes it as a single
+// S_BATCH message per recipient and send class, so a turn costs each player one datagram instead of
+// four and chat never shares a batch, or a channel, with game state.
+// Recipients are keyed by slot; streams are kept between flushes so steady state does not allocate.
+class OutgoingBatch
+{
+public:
+	explicit OutgoingBatch(RakNet::RakPeerInterface* rpi);
+
+	void Queue(PlayerSlot slot, const RakNet::SystemAddress& address, const RakNet::BitStream* bs);
+	void Queue(PlayerSlot slot, const RakNet::SystemAddress& address, const char* data, unsigned int length);
+	// Sends each recipient's messages, game state first. A lone message goes out as-is without the batch header
+	void Flush();
+
+private:
+	struct Batch
+	{
+		std::unique_ptr<RakNet::BitStream> stream;
+		unsigned int messageCount;
+	};
+
+	struct Recipient
+	{
+		RakNet::SystemAddress address;
+		Batch batches[SEND_CLASS_COUNT];
+		bool isPending;
+	};
+
+	void Flush(Recipient& recipient);
+	void Flush(const RakNet::SystemAddress& address, Batch& batch, SendClass sendClass);
+	Recipient& GetRecipient(PlayerSlot slot, const RakNet::SystemAddress& address);
+	bool IsEmpty(const Recipient& recipient) const;
+
+	RakNet::RakPeerInterface* rpi;
+	std::vector<Recipient> recipients;
+	std::vector<PlayerSlot> pending;
+};
@@ -0,0 +1,301 @@
+#include "playertable.h"
+
+#include <algorithm>
+
+PlayerSlot PlayerTable::Add(RakNet::RakNetGUID guid, const RakNet::SystemAddress& address, const char* name)
+{
+	if (info.size() >= MAX_PLAYERS || index.FindByGUID(guid.g) != NO_PLAYER_SLOT)
+		return NO_PLAYER_SLOT;
+
+	PlayerSlot slot = (PlayerSlot)info.size();
+	const std::string* internedName = index.AddName(name, slot);
+	if (internedName == nullptr)
+		return NO_PLAYER_SLOT;
+
+	index.AddGUID(guid.g, slot);
+	health.push_back(100);
+	dead.push_back(false);
+	nextAlive.push_back(slot);
+	prevAlive.push_back(slot);
+	job.push_back(CharacterClass::Wizard);
+	ready.push_back(false);
+	dirtyStats.push_back(0);
+	info.push_back(PlayerInfo{ internedName, guid, address, true });
+	connectedCount++;
+	rosterVersion++;
+
+	if (firstAlive == NO_PLAYER_SLOT)
+		firstAlive = slot;
+	else
+	{
+		// Joins the ring at the tail, just before the first living slot
+		PlayerSlot last = prevAlive[firstAlive];
+		nextAlive[last] = slot;
+		prevAlive[slot] = last;
+		nextAlive[slot] = firstAlive;
+		prevAlive[firstAlive] = slot;
+	}
+	aliveCount++;
+	return slot;
+}
+
+void PlayerTable::Remove(PlayerSlot slot)
+{
+	if (info[slot].connected)
+		connectedCount--;
+
+	rosterVersion++;
+	index.RemoveGUID(info[slot].guid.g);
+	index.RemoveName(*info[slot].name);
+
+	PlayerSlot last = (PlayerSlot)(info.size() - 1);
+	if (slot != last)
+	{
+		index.SetGUIDSlot(info[last].guid.g, slot);
+		index.SetNameSlot(*info[last].name, slot);
+		health[slot] = health[last];
+		dead[slot] = dead[last];
+		job[slot] = job[last];
+		ready[slot] = ready[last];
+		dirtyStats[slot] = dirtyStats[last];
+		info[slot] = std::move(info[last]);
+	}
+
+	health.pop_back();
+	dead.pop_back();
+	job.pop_back();
+	ready.pop_back();
+	dirtyStats.pop_back();
+	info.pop_back();
+	nextAlive.pop_back();
+	prevAlive.pop_back();
+
+	dirtySlots.erase(std::remove(dirtySlots.begin(), dirtySlots.end(), slot), dirtySlots.end());
+	std::replace(dirtySlots.begin(), dirtySlots.end(), last, slot);
+
+	// Slots were renumbered, only happens in the lobby so rebuilding is cheap
+	LinkAll();
+}
+
+void PlayerTable::LinkAll()
+{
+	aliveCount = 0;
+	firstAlive = NO_PLAYER_SLOT;
+	PlayerSlot last = NO_PLAYER_SLOT;
+	for (size_t i = 0; i < dead.size(); i++)
+	{
+		if (dead[i])
+			continue;
+
+		PlayerSlot slot = (PlayerSlot)i;
+		if (last == NO_PLAYER_SLOT)
+			firstAlive = slot;
+		else
+		{
+			nextAlive[last] = slot;
+			prevAlive[slot] = last;
+		}
+		last = slot;
+		aliveCount++;
+	}
+
+	if (last != NO_PLAYER_SLOT)
+	{
+		nextAlive[last] = firstAlive;
+		prevAlive[firstAlive] = last;
+	}
+}
+
+void PlayerTable::Disconnect(PlayerSlot slot)
+{
+	if (!info[slot].connected)
+		return;
+
+	info[slot].connected = false;
+	connectedCount--;
+}
+
+void PlayerTable::Rebind(PlayerSlot slot, RakNet::RakNetGUID guid, const RakNet::SystemAddress& address)
+{
+	index.RemoveGUID(info[slot].guid.g);
+	index.AddGUID(guid.g, slot);
+	info[slot].guid = guid;
+	info[slot].address = address;
+	if (!info[slot].connected)
+	{
+		info[slot].connected = true;
+		connectedCount++;
+	}
+}
+
+unsigned int PlayerTable::GetSize() const
+{
+	return (unsigned int)info.size();
+}
+
+unsigned int PlayerTable::GetConnectedCount() const
+{
+	return connectedCount;
+}
+
+unsigned int PlayerTable::GetAliveCount() const
+{
+	return aliveCount;
+}
+
+bool PlayerTable::AreAllReady() const
+{
+	for (unsigned char isReady : ready)
+		if (!isReady)
+			return false;
+
+	return true;
+}
+
+void PlayerTable::SetAllReady(bool isReady)
+{
+	std::fill(ready.begin(), ready.end(), isReady);
+	rosterVersion++;
+}
+
+unsigned int PlayerTable::GetRosterVersion() const
+{
+	return rosterVersion;
+}
+
+PlayerSlot PlayerTable::FindByGUID(RakNet::RakNetGUID guid) const
+{
+	return index.FindByGUID(guid.g);
+}
+
+PlayerSlot PlayerTable::FindByName(const std::string& name) const
+{
+	return index.FindByName(name);
+}
+
+PlayerSlot PlayerTable::NextAlive(PlayerSlot slot) const
+{
+	if (aliveCount == 0)
+		return NO_PLAYER_SLOT;
+
+	// Every dead slot points at one that died later or is still alive, so this ends
+	PlayerSlot next = nextAlive[slot];
+	while (dead[next])
+		next = nextAlive[next];
+
+	return next;
+}
+
+PlayerSlot PlayerTable::GetFirstAlive() const
+{
+	return firstAlive;
+}
+
+const std::vector<PlayerSlot>& PlayerTable::GetDirtySlots() const
+{
+	return dirtySlots;
+}
+
+unsigned char PlayerTable::GetDirtyStats(PlayerSlot slot) const
+{
+	return dirtyStats[slot];
+}
+
+void PlayerTable::ClearDirtyStats()
+{
+	for (PlayerSlot slot : dirtySlots)
+		dirtyStats[slot] = 0;
+
+	dirtySlots.clear();
+}
+
+void PlayerTable::MarkDirty(PlayerSlot slot, unsigned char stats)
+{
+	if (dirtyStats[slot] == 0)
+		dirtySlots.push_back(slot);
+
+	dirtyStats[slot] |= stats;
+}
+
+int PlayerTable::GetHealth(PlayerSlot slot) const
+{
+	return health[slot];
+}
+
+void PlayerTable::SetHealth(PlayerSlot slot, int value)
+{
+	health[slot] = value;
+	MarkDirty(slot, STAT_HEALTH);
+}
+
+bool PlayerTable::IsDead(PlayerSlot slot) const
+{
+	return dead[slot] != 0;
+}
+
+void PlayerTable::Kill(PlayerSlot slot)
+{
+	if (dead[slot])
+		return;
+
+	dead[slot] = true;
+	MarkDirty(slot, STAT_DEAD);
+	aliveCount--;
+	if (aliveCount == 0)
+	{
+		firstAlive = NO_PLAYER_SLOT;
+		return;
+	}
+
+	PlayerSlot prev = prevAlive[slot];
+	PlayerSlot next = nextAlive[slot];
+	nextAlive[prev] = next;
+	prevAlive[next] = prev;
+	if (firstAlive == slot)
+		firstAlive = next;
+}
+
+CharacterClass PlayerTable::GetJob(PlayerSlot slot) const
+{
+	return job[slot];
+}
+
+void PlayerTable::SetJob(PlayerSlot slot, CharacterClass value)
+{
+	job[slot] = value;
+	MarkDirty(slot, STAT_JOB);
+}
+
+bool PlayerTable::IsReady(PlayerSlot slot) const
+{
+	return ready[slot] != 0;
+}
+
+void PlayerTable::SetReady(PlayerSlot slot, bool isReady)
+{
+	if (ready[slot] == isReady)
+		return;
+
+	ready[slot] = isReady;
+	rosterVersion++;
+}
+
+const std::string& PlayerTable::GetName(PlayerSlot slot) const
+{
+	return *info[slot].name;
+}
+
+RakNet::RakNetGUID PlayerTable::GetGUID(PlayerSlot slot) const
+{
+	return info[slot].guid;
+}
+
+const RakNet::SystemAddress& PlayerTable::GetAddress(PlayerSlot slot) const
+{
+	return info[slot].address;
+}
+
+bool PlayerTable::IsConnected(PlayerSlot slot) const
+{
+	return info[slot].connected;
+}
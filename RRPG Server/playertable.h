@@ -0,0 +1,91 @@
+#pragma once
+#include "RRPG_Player.h"
+#include "RRPG_PlayerIndex.h"
+
+#include "RakNetTypes.h"
+#include <string>
+#include <vector>
+
+// A match's players stored column-wise and indexed by a dense slot id, so stat replies only walk
+// the few bytes they need. Names and addresses live in a side table
+// since only messages read them; lookups by GUID or name go through a hashed index.
+class PlayerTable
+{
+public:
+	static const unsigned int MAX_PLAYERS = NO_PLAYER_SLOT;
+
+	// Returns NO_PLAYER_SLOT if the table is full or the GUID or name is already in it
+	PlayerSlot Add(RakNet::RakNetGUID guid, const RakNet::SystemAddress& address, const char* name);
+	// Lobby only, the last player is moved into the freed slot to keep slots dense
+	void Remove(PlayerSlot slot);
+	// Mid-game leave, the slot is kept so turn order stays intact
+	void Disconnect(PlayerSlot slot);
+	// Hands the slot to the player's new connection after they resume, connected again
+	void Rebind(PlayerSlot slot, RakNet::RakNetGUID guid, const RakNet::SystemAddress& address);
+
+	unsigned int GetSize() const;
+	unsigned int GetConnectedCount() const;
+	unsigned int GetAliveCount() const;
+	bool AreAllReady() const;
+	void SetAllReady(bool isReady);
+	// Bumped whenever a name or ready flag in the player list changes, starts above 0 so a client
+	// that has never seen the list always gets it
+	unsigned int GetRosterVersion() const;
+
+	PlayerSlot FindByGUID(RakNet::RakNetGUID guid) const;
+	PlayerSlot FindByName(const std::string& name) const;
+	// Next living slot after the given one in turn order, wrapping around. The given slot may have
+	// died since it was current. NO_PLAYER_SLOT if nobody is alive
+	PlayerSlot NextAlive(PlayerSlot slot) const;
+	PlayerSlot GetFirstAlive() const;
+
+	int GetHealth(PlayerSlot slot) const;
+	void SetHealth(PlayerSlot slot, int value);
+	bool IsDead(PlayerSlot slot) const;
+	// Unlinks the slot from the alive ring, dead players stay dead
+	void Kill(PlayerSlot slot);
+
+	// Replicated stats changed since the last ClearDirtyStats, as PlayerStat bits
+	const std::vector<PlayerSlot>& GetDirtySlots() const;
+	unsigned char GetDirtyStats(PlayerSlot slot) const;
+	void ClearDirtyStats();
+	CharacterClass GetJob(PlayerSlot slot) const;
+	void SetJob(PlayerSlot slot, CharacterClass value);
+	bool IsReady(PlayerSlot slot) const;
+	void SetReady(PlayerSlot slot, bool isReady);
+
+	const std::string& GetName(PlayerSlot slot) const;
+	RakNet::RakNetGUID GetGUID(PlayerSlot slot) const;
+	const RakNet::SystemAddress& GetAddress(PlayerSlot slot) const;
+	bool IsConnected(PlayerSlot slot) const;
+
+private:
+	void LinkAll();
+	void MarkDirty(PlayerSlot slot, unsigned char stats);
+
+	struct PlayerInfo
+	{
+		// Interned by the index
+		const std::string* name;
+		RakNet::RakNetGUID guid;
+		RakNet::SystemAddress address;
+		bool connected;
+	};
+
+	std::vector<int> health;
+	std::vector<unsigned char> dead;
+	// Living slots form a ring in slot order. A dead slot keeps the next pointer it had when it
+	// was unlinked, so the turn can still advance from it
+	std::vector<PlayerSlot> nextAlive;
+	std::vector<PlayerSlot> prevAlive;
+	std::vector<CharacterClass> job;
+	std::vector<unsigned char> ready;
+	std::vector<unsigned char> dirtyStats;
+	std::vector<PlayerSlot> dirtySlots;
+	std::vector<PlayerInfo> info;
+	PlayerIndex index;
+	unsigned int connectedCount = 0;
+	unsigned int rosterVersion = 1;
+	unsigned int aliveCount = 0;
+	PlayerSlot firstAlive = NO_PLAYER_SLOT;
+};
@@ -0,0 +1,43 @@
+#include "scratcharena.h"
+
+ScratchArena::Scope::Scope()
+	: arena(ScratchArena::Get()), top(arena.top), overflowCount(arena.overflow.size())
+{
+}
+
+ScratchArena::Scope::~Scope()
+{
+	while (arena.overflow.size() > overflowCount)
+	{
+		delete[] arena.overflow.back();
+		arena.overflow.pop_back();
+	}
+	arena.top = top;
+}
+
+ScratchArena::ScratchArena()
+	: top(0)
+{
+	overflow.reserve(16);
+}
+
+ScratchArena& ScratchArena::Get()
+{
+	thread_local ScratchArena arena;
+	return arena;
+}
+
+char* ScratchArena::Allocate(size_t size)
+{
+	// Keep every buffer aligned for whatever it ends up holding
+	size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+	if (size > CAPACITY - top)
+	{
+		overflow.push_back(new char[size]);
+		return overflow.back();
+	}
+
+	char* result = buffer + top;
+	top += size;
+	return result;
+}
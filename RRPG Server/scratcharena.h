@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Per-thread bump allocator for buffers that only live as long as one handler call.
+// Open a Scope, take buffers from Get(), and everything taken is handed back when the scope ends.
+// Requests that do not fit fall back to the heap and are freed with the scope.
+class ScratchArena
+{
+public:
+	static const size_t CAPACITY = 64 * 1024;
+
+	class Scope
+	{
+	public:
+		Scope();
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		ScratchArena& arena;
+		size_t top;
+		size_t overflowCount;
+	};
+
+	static ScratchArena& Get();
+
+	char* Allocate(size_t size);
+
+private:
+	ScratchArena();
+
+	char buffer[CAPACITY];
+	size_t top;
+	std::vector<char*> overflow;
+};
@@ -1,51 +1,39 @@
 #include "server.h"
+#include "RRPG_Messages.h"
+#include "RRPG_SendPolicy.h"
+#include "allocationcounter.h"
+#include "log.h"
+#include "messagestats.h"
 
 #include "RakNetSocket2.h"
 #include "BitStream.h"
-#include "StringCompressor.h"
+#include "GetTime.h"
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <mutex>
-#include <random>
 
-unsigned int Server::EXPECTED_PLAYERS = 3;
+unsigned int Server::MAX_CONNECTIONS = 4096;
 Server* Server::instance = nullptr;
-
-namespace
-{
-	unsigned char GetPacketIdentifier(RakNet::Packet* packet)
-	{
-		if (packet == nullptr)
-			return 255;
-
-		if ((unsigned char)packet->data[0] == ID_TIMESTAMP)
-		{
-			RakAssert(packet->length > sizeof(RakNet::MessageID) + sizeof(RakNet::Time));
-			return (unsigned char)packet->data[sizeof(RakNet::MessageID) + sizeof(RakNet::Time)];
-		}
-		else
-		{
-			return (unsigned char)packet->data[0];
-		}
-	}
-	
-	std::random_device rd;
-	std::mt19937 rng(rd());
-	int GetRandomInteger(int min, int max)
-	{
-		std::uniform_int_distribution<int> uni(min, max);
-		return uni(rng);
-	}
-}
+int Server::MAX_IDLE_WAIT_MS = 1000;
+// 0 turns the periodic dump off
+int Server::LATENCY_DUMP_INTERVAL_MS = 0;
 
 Server::Server()
+	: rpi(RakNet::RakPeerInterface::GetInstance()), matchManager(rpi, pump)
 {
 	networkState = NS_INITIALIZATION;
-	rpi = RakNet::RakPeerInterface::GetInstance();
+	totalConnections = 0;
+	isRecording = false;
+	isReplaying = false;
+	isQuitting = false;
+	isLatencyRequested = false;
+	nextLatencyDump = RakNet::GetTimeMS() + LATENCY_DUMP_INTERVAL_MS;
 }
 
 void Server::Start()
 {
+	Log::Start();
 	std::cout << "RRPG Server" << std::endl;
 	std::cout << "Enter listening port: ";
 	std::cin >> port;
@@ -55,64 +43,192 @@ void Server::Start()
 
 	printf("IP Address: %s:%i\n", rpi->GetLocalIP(0), port);
 
+	networkState = NS_CREATE_SOCKET;
+	GameLoop();
+
+	matchManager.StartWorkers(std::thread::hardware_concurrency());
 	std::thread packetHandler(&Server::PacketHandler, this);
 	std::thread inputHandler(&Server::InputHandler, this);
-	networkState = NS_CREATE_SOCKET;
 
-	while (IsRunning())
+	packetHandler.join();
+	inputHandler.join();
+	Shutdown();
+}
+
+void Server::SetSeed(uint64_t seed)
+{
+	matchManager.SetSeed(seed);
+}
+
+bool Server::Record(const char* path)
+{
+	if (!recorder.Open(path, matchManager.GetSeed()))
+		return false;
+
+	matchManager.SetRecorder(&recorder);
+	isRecording = true;
+	return true;
+}
+
+bool Server::Replay(const char* path)
+{
+	SessionReader reader;
+	if (!reader.Open(path))
+		return false;
+
+	Log::Start();
+	matchManager.SetSeed(reader.GetSeed());
+	isReplaying = true;
+	matchManager.SetReplaying(true);
+	matchManager.StartWorkers(std::thread::hardware_concurrency());
+
+	// The peer is never started, so whatever the matches send goes nowhere
+	unsigned long long packets = 0, turns = 0;
+	RakNet::TimeUS start = RakNet::GetTimeUS();
+	SessionRecord record;
+	while (reader.Next(record))
 	{
-		GameLoop();
+		switch (record.kind)
+		{
+		case RECORD_PACKET:
+		{
+			RakNet::Packet* p = rpi->AllocatePacket(record.length);
+			memcpy(p->data, record.data, record.length);
+			p->guid = record.guid;
+			p->systemAddress = record.systemAddress;
+			unsigned char packetIdentifier = GetPacketIdentifier(p);
+			if (packetIdentifier == RRPG_ID::C_JOB_CHOSEN || packetIdentifier == RRPG_ID::C_ACTION_TAKEN)
+				turns++;
+
+			HandlePacket(p, record.time, record.ping);
+			packets++;
+			break;
+		}
+		case RECORD_GAME_LOOP:
+			matchManager.FormMatches(record.time);
+			break;
+		// Timers and teardowns happen where the live server made them happen, not by this clock
+		case RECORD_TIMER:
+			matchManager.ReplayTimer(record.matchID, record.type, record.turn);
+			break;
+		case RECORD_TEARDOWN:
+			matchManager.ReplayTeardown(record.matchID);
+			break;
+		case RECORD_REQUEUE:
+			matchManager.ReplayRequeue(record.matchID, record.guid);
+			break;
+		}
 	}
 
-	packetHandler.join();
-	inputHandler.join();
+	while (!matchManager.IsIdle())
+		std::this_thread::yield();
 
+	double seconds = (RakNet::GetTimeUS() - start) / 1000000.0;
+	Log::Write(LOG_SERVER, LOG_INFO, "Replayed %llu packets and %llu turns in %.3fs: %.0f packets/s, %.0f turns/s",
+		packets, turns, seconds, packets / seconds, turns / seconds);
+	unsigned long long sent = MessageStats::GetSentBytes();
+	Log::Write(LOG_SERVER, LOG_INFO, "Matches sent %llu bytes, %.1f per turn", sent, turns == 0 ? 0.0 : (double)sent / turns);
+	MessageStats::Print();
+	matchManager.PrintMatchmaking();
+
+	Shutdown();
+	matchManager.SetReplaying(false);
+	isReplaying = false;
+	return true;
+}
+
+void Server::Shutdown()
+{
+	matchManager.StopWorkers();
+	matchManager.ReleasePeer();
+	pump.Detach();
 	rpi->Shutdown(300);
+	if (isRecording)
+	{
+		recorder.Close();
+		isRecording = false;
+	}
+	// The instance outlives the peer, so nothing is left pointing at it
 	RakNet::RakPeerInterface::DestroyInstance(rpi);
+	rpi = nullptr;
+	Log::Stop();
 }
 
 void Server::PacketHandler()
 {
 	while (IsRunning())
 	{
-		for (RakNet::Packet* p = rpi->Receive(); p; rpi->DeallocatePacket(p), p = rpi->Receive())
+		pump.Wait(GetGameLoopDelay());
+
+		for (RakNet::Packet* p = rpi->Receive(); p; p = rpi->Receive())
 		{
-			if (!IsLowLevelPacketHandled(p))
-			{
-				unsigned char packetIdentifier = GetPacketIdentifier(p);
-
-				switch (packetIdentifier)
-				{
-				case RRPG_ID::C_INTRO:
-					OnClientIntro(p);
-					break;
-				case RRPG_ID::C_READY:
-					OnPlayerReady(p);
-					break;
-				case RRPG_ID::C_UNREADY:
-					OnPlayerUnready(p);
-					break;
-				case RRPG_ID::C_PLAYER_LIST_REQUEST:
-					OnPlayerListRequest(p);
-					break;
-				case RRPG_ID::C_PLAYER_STATS_REQUEST:
-					OnPlayerStatsRequest(p);
-					break;
-				case RRPG_ID::C_CHAT:
-					OnClientChatReceived(p);
-					break;
-				case RRPG_ID::C_JOB_CHOSEN:
-					OnPlayerJobChosen(p);
-					break;
-				case RRPG_ID::C_ACTION_TAKEN:
-					OnPlayerActionTaken(p);
-					break;
-				default:
-					printf("client packet with no ID: %s\n", p->data);
-					break;
-				}
-			}
+			// Only matchmaking needs the ping, and only when a player queues or readies
+			RakNet::TimeMS now = RakNet::GetTimeMS();
+			unsigned char packetIdentifier = GetPacketIdentifier(p);
+			int ping = packetIdentifier == RRPG_ID::C_INTRO || packetIdentifier == RRPG_ID::C_READY ? rpi->GetAveragePing(p->guid) : -1;
+			recorder.RecordPacket(p, now, ping);
+			HandlePacket(p, now, ping);
 		}
+
+		GameLoop();
+	}
+}
+
+void Server::HandlePacket(RakNet::Packet* p, RakNet::TimeMS now, int ping)
+{
+	if (IsLowLevelPacketHandled(p))
+		rpi->DeallocatePacket(p);
+	else
+		RoutePacketToMatch(p, now, ping);
+}
+
+void Server::RoutePacketToMatch(RakNet::Packet* p, RakNet::TimeMS now, int ping)
+{
+	unsigned char packetIdentifier = GetPacketIdentifier(p);
+	MatchCommand command;
+	if (!DecodeMatchCommand(p, command))
+	{
+		Log::Write(LOG_NETWORK, LOG_WARNING, "Malformed packet %i from %s", packetIdentifier, p->systemAddress.ToString(true));
+		rpi->DeallocatePacket(p);
+		return;
+	}
+
+	// Players wait in matchmaking from their intro until a match forms around them, and come back
+	// through it when they resume
+	if (matchManager.Matchmake(command, now, ping))
+		return;
+
+	Match* match = matchManager.GetMatch(p->guid);
+	if (match == nullptr)
+	{
+		Log::Write(LOG_NETWORK, LOG_WARNING, "Packet from %s which is not in a match", p->systemAddress.ToString(true));
+		rpi->DeallocatePacket(p);
+		return;
+	}
+
+	if (packetIdentifier == RRPG_ID::C_CHAT && !matchManager.AllowChat(command, now))
+	{
+		rpi->DeallocatePacket(p);
+		return;
+	}
+
+	if (packetIdentifier == ID_DISCONNECTION_NOTIFICATION)
+		matchManager.RemovePlayer(p->guid);
+	else if (packetIdentifier == ID_CONNECTION_LOST)
+		matchManager.OnConnectionLost(p->guid);
+
+	bool isPosted = matchManager.Post(*match, command);
+	// A replay has no clients to lose, so it waits for the match instead of dropping
+	while (!isPosted && isReplaying)
+	{
+		std::this_thread::yield();
+		isPosted = matchManager.Post(*match, command);
+	}
+
+	if (!isPosted)
+	{
+		Log::Write(LOG_NETWORK, LOG_WARNING, "Match %u mailbox is full, dropping packet %i", match->GetID(), packetIdentifier);
+		rpi->DeallocatePacket(p);
 	}
 }
 
@@ -122,8 +238,21 @@ void Server::InputHandler()
 	{
 		char input[2048];
 		std::cin.getline(input, sizeof(input));
-		if (input == ".quit")
+		if (strcmp(input, ".quit") == 0)
+		{
 			isQuitting = true;
+			pump.Wake();
+		}
+		else if (strcmp(input, ".allocs") == 0)
+			PrintHandlerAllocations();
+		else if (strcmp(input, ".latency") == 0)
+		{
+			// Matchmaking figures belong to the packet thread, so it prints them
+			isLatencyRequested = true;
+			pump.Wake();
+		}
+		else if (strncmp(input, ".loglevel", 9) == 0)
+			SetLogLevel(input);
 		else
 			BroadcastMessage(&input[0]);
 	}
@@ -137,40 +266,43 @@ bool Server::IsLowLevelPacketHandled(RakNet::Packet* p)
 	{
 	case ID_DISCONNECTION_NOTIFICATION:
 		// Connection lost normally
-		printf("ID_DISCONNECTION_NOTIFICATION\n");
-		break;
+		Log::Write(LOG_NETWORK, LOG_INFO, "ID_DISCONNECTION_NOTIFICATION from %s", p->systemAddress.ToString(true));
+		OnConnectionClosed(p);
+		// The player's match still has to hear about it
+		return false;
 	case ID_ALREADY_CONNECTED:
 		// Connection lost normally
-		printf("ID_ALREADY_CONNECTED");
+		Log::Write(LOG_NETWORK, LOG_WARNING, "ID_ALREADY_CONNECTED");
 // 		printf("ID_ALREADY_CONNECTED with guid %" PRINTF_64_BIT_MODIFIER "u\n", p->guid);
 		break;
 	case ID_INCOMPATIBLE_PROTOCOL_VERSION:
-		printf("ID_INCOMPATIBLE_PROTOCOL_VERSION\n");
+		Log::Write(LOG_NETWORK, LOG_WARNING, "ID_INCOMPATIBLE_PROTOCOL_VERSION");
 		break;
 	case ID_REMOTE_DISCONNECTION_NOTIFICATION: // Server telling the clients of another client disconnecting gracefully.  You can manually broadcast this in a peer to peer enviroment if you want.
-		printf("ID_REMOTE_DISCONNECTION_NOTIFICATION\n");
+		Log::Write(LOG_NETWORK, LOG_INFO, "ID_REMOTE_DISCONNECTION_NOTIFICATION");
 		totalConnections--;
 		break;
 	case ID_REMOTE_CONNECTION_LOST: // Server telling the clients of another client disconnecting forcefully.  You can manually broadcast this in a peer to peer enviroment if you want.
-		printf("ID_REMOTE_CONNECTION_LOST\n");
+		Log::Write(LOG_NETWORK, LOG_INFO, "ID_REMOTE_CONNECTION_LOST");
 		totalConnections--;
 		break;
 	case ID_NEW_INCOMING_CONNECTION:
 	case ID_REMOTE_NEW_INCOMING_CONNECTION: // Server telling the clients of another client connecting.  You can manually broadcast this in a peer to peer enviroment if you want.
-		printf("ID_REMOTE_NEW_INCOMING_CONNECTION\n");
+		Log::Write(LOG_NETWORK, LOG_INFO, "ID_REMOTE_NEW_INCOMING_CONNECTION");
 		OnIncomingConnection(p);
 		break;
 	case ID_CONNECTION_ATTEMPT_FAILED:
-		printf("Connection attempt failed\n");
+		Log::Write(LOG_NETWORK, LOG_WARNING, "Connection attempt failed");
 		break;
 	case ID_CONNECTION_LOST:
 		// Couldn't deliver a reliable packet - i.e. the other system was abnormally
 		// terminated
-		printf("ID_CONNECTION_LOST\n");
-		break;
+		Log::Write(LOG_NETWORK, LOG_INFO, "ID_CONNECTION_LOST from %s", p->systemAddress.ToString(true));
+		OnConnectionClosed(p);
+		return false;
 	case ID_CONNECTED_PING:
 	case ID_UNCONNECTED_PING:
-		printf("Ping from %s\n", p->systemAddress.ToString(true));
+		Log::Write(LOG_NETWORK, LOG_DEBUG, "Ping from %s", p->systemAddress.ToString(true));
 		break;
 	default:
 		return false;
@@ -181,253 +313,12 @@ bool Server::IsLowLevelPacketHandled(RakNet::Packet* p)
 
 void Server::OnIncomingConnection(RakNet::Packet* p)
 {
-	std::lock_guard<std::mutex> guard(totalPlayers_mutex);
 	totalConnections++;
 }
 
-void Server::OnClientIntro(RakNet::Packet* p)
-{
-	std::lock_guard<std::mutex> guard(totalPlayers_mutex);
-	if (totalConnections > EXPECTED_PLAYERS)
-	{
-		rpi->CloseConnection(p->systemAddress, true);
-		totalConnections--;
-	}
-	
-	playerAddresses.emplace(RakNet::RakNetGUID::ToUint32(p->guid), p->systemAddress);
-
-	char* name = new char[256];
-	RakNet::BitStream bs(p->data, p->length, false);
-	bs.IgnoreBits(8);
-	RakNet::StringCompressor::Instance()->DecodeString(name, 256, &bs);
-	bool ready;
-	bs.Read(ready);
-
-	players.emplace(RakNet::RakNetGUID::ToUint32(p->guid), Player{ std::string(name) });
-	memcpy(name + strlen(name), " has joined.", 13);
-	BroadcastMessage(name);
-
-	if (totalConnections != EXPECTED_PLAYERS)
-	{
-		char buffer[40];
-		snprintf(buffer, 40, "Waiting for %i more player%s..", 
-			EXPECTED_PLAYERS - totalConnections, 
-			(EXPECTED_PLAYERS - totalConnections == 1 ? "." : "s.")
-		);
-		BroadcastMessage(&buffer[0]);
-	}
-	delete[] name;
-}
-
-void Server::OnClientChatReceived(RakNet::Packet* p)
-{
-	Player player = GetPlayer(p->guid);
-	char* cmsg = new char[2048];
-	char* message = new char[2048 + player.name.length()];
-
-	RakNet::BitStream bs(p->data, p->length, false);
-	bs.IgnoreBits(8);
-	RakNet::StringCompressor::Instance()->DecodeString(cmsg, 2048, &bs);
-
-	memcpy(message, player.name.c_str(), player.name.length());
-	memcpy(message + player.name.length(), ": ", 2);
-	memcpy(message + player.name.length() + 2, cmsg, strlen(cmsg) + 1);
-
-	std::cout << message << std::endl;
-	rpi->Send(message, (const int)strlen(message) + 1, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
-
-	delete[] cmsg;
-	delete[] message;
-}
-
-void Server::OnPlayerReady(RakNet::Packet* p)
-{
-	std::lock_guard<std::mutex> guard(totalPlayers_mutex);
-	Player& player = GetPlayer(p->guid);
-	player.ready = true;
-	std::string msg = player.name + " is ready.";
-	BroadcastMessage(msg.c_str());
-
-	for (const auto& it : players)
-		if (!it.second.ready)
-			return;
-
-	if (totalConnections == EXPECTED_PLAYERS)
-		StartGame();
-}
-
-void Server::OnPlayerUnready(RakNet::Packet* p)
+void Server::OnConnectionClosed(RakNet::Packet* p)
 {
-	std::lock_guard<std::mutex> guard(totalPlayers_mutex);
-	Player& player = GetPlayer(p->guid);
-	player.ready = false;
-	std::string msg = player.name + " is not ready.";
-	BroadcastMessage(msg.c_str());
-}
-
-void Server::OnPlayerListRequest(RakNet::Packet* p)
-{
-	RakNet::BitStream bs;
-	bs.Write((unsigned char)RRPG_ID::S_REPLY_PLAYER_LIST_REQUEST);
-	bs.Write((int)players.size());
-	for (const auto& it : players)
-	{
-		RakNet::StringCompressor::Instance()->EncodeString(it.second.name.c_str(), 256, &bs);
-		bs.Write(it.second.ready);
-	}
-
-	rpi->Send(&bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, p->systemAddress, false);
-}
-
-void Server::OnPlayerJobChosen(RakNet::Packet* p)
-{
-	Player& player = GetPlayer(p->guid);
-	player.ready = true;
-
-	RakNet::BitStream bs(p->data, p->length, false);
-	bs.IgnoreBits(8);
-	bs.Read(player.job);
-	
-	char buffer[1024];
-	snprintf(buffer, 1024, "%s has chosen to be a %s\n", player.name.c_str(),
-		(player.job == CharacterClass::Wizard ? "Wizard" :
-			player.job == CharacterClass::Warrior ? "Warrior" :
-			player.job == CharacterClass::Assassin ? "Assassin" :
-			"Jobless"));
-
-	BroadcastMessage(&buffer[0]);
-
-	auto it = players.find(currentPlayerTurn);
-	it++;
-
-	if (it == players.end())
-		StartMainGame();
-	else
-	{
-		currentPlayerTurn = it->first;
-		RakNet::BitStream ttBs;
-		ttBs.Write((unsigned char)RRPG_ID::S_TAKE_TURN);
-		rpi->Send(&ttBs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, GetAddressFromID(currentPlayerTurn), false);
-	}
-}
-
-void Server::OnPlayerStatsRequest(RakNet::Packet* p)
-{
-	RakNet::BitStream bs;
-	bs.Write((unsigned char)RRPG_ID::S_REPLY_PLAYER_STATS_REQUEST);
-	bs.Write((int)players.size());
-	for (const auto& it : players)
-	{
-		RakNet::StringCompressor::Instance()->EncodeString(it.second.name.c_str(), 256, &bs);
-		bs.Write(it.second.job);
-		bs.Write(it.second.health);
-	}
-
-	rpi->Send(&bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, p->systemAddress, false);
-}
-
-void Server::OnPlayerActionTaken(RakNet::Packet* p)
-{
-	Action action;
-	char* tname = new char[256];
-	RakNet::BitStream bs(p->data, p->length, false);
-	bs.IgnoreBits(8);
-	bs.Read(action);
-	RakNet::StringCompressor::Instance()->DecodeString(tname, 256, &bs);
-
-	Player* target = GetPlayerWithName(tname);
-	Player& origin = GetPlayer(p->guid);
-	assert(target != nullptr);
-
-	char buffer[256];
-	switch (action)
-	{
-		case Action::Heal:
-		{			
-			snprintf(buffer, 256, "%s The %s healed %s The %s for %i", 
-				origin.name.c_str(), GetStringFromClass(origin.job), target->name.c_str(), GetStringFromClass(target->job), 10);
-			BroadcastMessage(&buffer[0]);
-			ModifyHealth(*target, 10);
-			break;
-		}
-		case Action::HealRng:
-		{
-			int healAmount = GetRandomInteger(5, 15);
-			snprintf(buffer, 256, "%s The %s randomly healed %s The %s for %i",
-				origin.name.c_str(), GetStringFromClass(origin.job), target->name.c_str(), GetStringFromClass(target->job), healAmount);
-			BroadcastMessage(&buffer[0]);
-			ModifyHealth(*target, healAmount);
-			break;
-		}
-		case Action::Attack:
-		{			
-			snprintf(buffer, 256, "%s The %s attacked %s The %s for %i", 
-				origin.name.c_str(), GetStringFromClass(origin.job), target->name.c_str(), GetStringFromClass(target->job), 12);
-			BroadcastMessage(&buffer[0]);
-			ModifyHealth(*target, -12);
-			break;
-		}
-		case Action::AtkRng:
-		{
-			int atkAmount = -GetRandomInteger(6, 18);			
-			snprintf(buffer, 256, "%s The %s randomly attacked %s The %s for %i",
-				origin.name.c_str(), GetStringFromClass(origin.job), target->name.c_str(), GetStringFromClass(target->job), -atkAmount);
-			BroadcastMessage(&buffer[0]);
-			ModifyHealth(*target, atkAmount);
-			break;
-		}
-	}
-
-	NextTurn();
-	delete[] tname;
-}
-
-void Server::NextTurn()
-{
-	auto it = players.find(currentPlayerTurn);
-	it++;
-
-	while (it == players.end() || it->second.dead)
-	{
-		if (it == players.end())
-			it = players.begin();
-		else
-			it++;
-	}
-
-	currentPlayerTurn = it->first;
-
-	if (std::count_if(players.begin(), players.end(), [](std::pair<unsigned long, Player> p) { return p.second.dead == false; }) == 1)
-	{
-		GameOver(currentPlayerTurn);
-		return;
-	}
-
-
-	char buffer[256];
-	snprintf(buffer, 256, "%s's turn", it->second.name.c_str());
-	BroadcastMessage(&buffer[0]);
-
-	RakNet::BitStream ttBs;
-	ttBs.Write((unsigned char)RRPG_ID::S_TAKE_TURN);
-	rpi->Send(&ttBs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, GetAddressFromID(currentPlayerTurn), false);
-}
-
-void Server::ModifyHealth(Player& player, int diff)
-{
-	player.health += diff;
-	RakNet::BitStream bs;
-	bs.Write((unsigned char)RRPG_ID::S_UPDATE_PLAYER_HP);
-	RakNet::StringCompressor::Instance()->EncodeString(player.name.c_str(), (int) player.name.length() + 1, &bs);
-	bs.Write(player.health);
-	if (player.health > 0)
-		printf("Internal: %s is now at %i health\n", player.name.c_str(), player.health);
-	else
-	{
-		printf("Internal: %s is dead\n", player.name.c_str());
-		player.dead = true;
-	}
-	rpi->Send(&bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
+	totalConnections--;
 }
 
 void Server::GameLoop()
@@ -437,95 +328,69 @@ void Server::GameLoop()
 		RakNet::SocketDescriptor socketDescriptors[1];
 		socketDescriptors[0].port = port;
 		socketDescriptors[0].socketFamily = AF_INET;
-		assert(rpi->Startup(EXPECTED_PLAYERS, socketDescriptors, 1) == RakNet::RAKNET_STARTED);
-		rpi->SetMaximumIncomingConnections(EXPECTED_PLAYERS);
+		assert(rpi->Startup(MAX_CONNECTIONS, socketDescriptors, 1) == RakNet::RAKNET_STARTED);
+		rpi->SetMaximumIncomingConnections(MAX_CONNECTIONS);
+		pump.Attach(rpi);
 		networkState_mutex.lock();
-		networkState = NS_LOBBY;
+		networkState = NS_LISTENING;
 		networkState_mutex.unlock();
-		std::cout << "Server waiting on connections..." << std::endl;
+		Log::Write(LOG_SERVER, LOG_INFO, "Server waiting on connections...");
 	}
-}
-
-void Server::StartGame()
-{
-	std::cout << "Internal: Game has started." << std::endl;
-	networkState = NS_GAME_STARTED;
-	gameState = GS_CHARACTER_SELECT;
-	RakNet::BitStream bs;
-	bs.Write((unsigned char)RRPG_ID::S_GAME_STARTED);
-	rpi->Send(&bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
-
-	for (auto& it : players)
-		it.second.ready = false;
-
-	auto it = players.begin();
-	currentPlayerTurn = it->first;
-	
-	RakNet::BitStream ttBs;
-	ttBs.Write((unsigned char)RRPG_ID::S_TAKE_TURN);
-	rpi->Send(&ttBs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, GetAddressFromID(currentPlayerTurn), false);
-}
-
-void Server::StartMainGame()
-{
-	gameState = GS_MAIN;
-	RakNet::BitStream gsBs;
-	gsBs.Write((unsigned char)RRPG_ID::S_UPDATE_GAME_STATE);
-	gsBs.Write(gameState);
-	gsBs.Write((int)players.size());
-	for (const auto& it : players)
+	else if (networkState == NS_LISTENING)
 	{
-		RakNet::StringCompressor::Instance()->EncodeString(it.second.name.c_str(), 256, &gsBs);
-		gsBs.Write(it.second.health);
-		gsBs.Write(it.second.ready);
-		gsBs.Write(it.second.job);
+		RakNet::TimeMS now = RakNet::GetTimeMS();
+		recorder.RecordGameLoop(now);
+		matchManager.FormMatches(now);
+		matchManager.UpdateTimers(now);
+		matchManager.CollectFinishedMatches();
+		if (isLatencyRequested.exchange(false) || (LATENCY_DUMP_INTERVAL_MS > 0 && (int)(now - nextLatencyDump) >= 0))
+			PrintMessageLatencies();
 	}
-
-	rpi->Send(&gsBs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
-	NextTurn();
 }
 
-void Server::GameOver(unsigned long winnerId)
+void Server::PrintHandlerAllocations() const
 {
-	gameState = GS_GAME_OVER;
-	Player& player = GetPlayer(winnerId);
-	char buffer[256];
-	snprintf(buffer, 256, "%s wins!", player.name.c_str());
-	BroadcastMessage(&buffer[0]);
-	RakNet::BitStream bs;
-	bs.Write((unsigned char)RRPG_ID::S_UPDATE_GAME_STATE);
-	bs.Write(gameState);
-	
-	rpi->Send(&bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
+	unsigned long long commands, allocations;
+	AllocationCounter::GetHandlerTotals(commands, allocations);
+	Log::Write(LOG_SERVER, LOG_INFO, "%llu allocations over %llu commands (%.2f per command)",
+		allocations, commands, commands == 0 ? 0.0 : (double)allocations / commands);
 }
 
-Player& Server::GetPlayer(RakNet::RakNetGUID id)
+void Server::PrintMessageLatencies()
 {
-	unsigned long guid = RakNet::RakNetGUID::ToUint32(id);
-	return GetPlayer(guid);
+	nextLatencyDump = RakNet::GetTimeMS() + LATENCY_DUMP_INTERVAL_MS;
+	MessageStats::Print();
+	matchManager.PrintMatchmaking();
 }
 
-Player& Server::GetPlayer(unsigned long id)
+void Server::SetLogLevel(const char* input)
 {
-	auto it = players.find(id);
-	assert(it != players.end());
-	return it->second;
+	char subsystemName[16], levelName[16];
+	LogSubsystem subsystem;
+	LogLevel level;
+	if (sscanf(input, ".loglevel %15s %15s", subsystemName, levelName) != 2
+		|| !Log::FindSubsystem(subsystemName, subsystem) || !Log::FindLevel(levelName, level))
+	{
+		printf("Usage: .loglevel <network|match|chat|server> <debug|info|warning|error|off>\n");
+		return;
+	}
+
+	Log::SetLevel(subsystem, level);
 }
 
-Player* Server::GetPlayerWithName(const char* name)
+int Server::GetGameLoopDelay() const
 {
-	for (auto& it : players)
-		if (it.second.name == name)
-			return &it.second;
+	// Otherwise only wake for packets or to notice RakNet's own events
+	RakNet::TimeMS now = RakNet::GetTimeMS();
+	int delay = MAX_IDLE_WAIT_MS;
+	if (LATENCY_DUMP_INTERVAL_MS > 0)
+		delay = std::max(0, std::min(delay, (int)(nextLatencyDump - now)));
 
-	return nullptr;
-}
+	int matchDelay = matchManager.GetDelay(now);
+	if (matchDelay >= 0)
+		delay = std::min(delay, matchDelay);
 
-RakNet::SystemAddress Server::GetAddressFromID(unsigned long id)
-{
-	auto it = playerAddresses.find(id);
-	assert(it != playerAddresses.end());
-	return it->second;
+	return delay;
 }
 
 void Server::BroadcastMessage(const char* input)
@@ -534,12 +399,13 @@ void Server::BroadcastMessage(const char* input)
 		return;
 
 	const static char prefix[] = "[Server] ";
-	char* message = new char[2048 + strlen(prefix)];
+	char message[sizeof(prefix) + 2048];
 	memcpy(message, prefix, strlen(prefix));
 	memcpy(message + strlen(prefix), input, strlen(input) + 1);
-	printf("Broadcast: %s\n", message);
-	rpi->Send(message, (const int)strlen(message) + 1, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
-	delete[] message;
+	Log::Write(LOG_CHAT, LOG_INFO, "%s", message);
+	RakNet::BitStream bs;
+	ChatMessage::Write(&bs, message);
+	SendWithPolicy(rpi, &bs, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
 }
 
 bool Server::IsRunning() const
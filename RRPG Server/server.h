@@ -1,17 +1,28 @@
 #pragma once
-#include "RRPG_Player.h"
+#include "matchmanager.h"
+#include "sessionrecording.h"
 #include "RRPG_MessageIdentifiers.h"
+#include "RRPG_PacketPump.h"
 
 #include "RakPeerInterface.h"
+#include <atomic>
 #include <string>
 #include <mutex>
-#include <map>
 
 class Server
 {
 public:
 	Server();
 	void Start();
+	// Call before Start or Record to fix the match seed
+	void SetSeed(uint64_t seed);
+	// Call before Start to append every packet the session receives to the file, along with when
+	// matchmaking ran, timers fired and matches were torn down
+	bool Record(const char* path);
+	// Feeds a recording through the packet handlers as fast as the matches take it, without a socket
+	// or console, and reports throughput. Uses the recorded seed and fires timers and tears matches down
+	// where the recording did, so the games play out as they did
+	bool Replay(const char* path);
 
 	static Server& Get()
 	{
@@ -26,41 +37,32 @@ private:
 	{
 		NS_INITIALIZATION,
 		NS_CREATE_SOCKET,
-		NS_LOBBY,
-		NS_GAME_STARTED
+		NS_LISTENING
 	};
 
+	// Stops the matches and destroys the peer, the last thing Start and Replay do
+	void Shutdown();
 	void PacketHandler();
+	// Takes ownership of p. now and ping are when it arrived and, for packets matchmaking buckets by,
+	// the sender's ping; a replay passes the recorded ones
+	void HandlePacket(RakNet::Packet* p, RakNet::TimeMS now, int ping);
 	void InputHandler();
 	bool IsLowLevelPacketHandled(RakNet::Packet* p);
+	void RoutePacketToMatch(RakNet::Packet* p, RakNet::TimeMS now, int ping);
 
 	void OnIncomingConnection(RakNet::Packet* p);
-	// OnConnectionAccepted ->
-	void OnClientIntro(RakNet::Packet* p);
-	void OnClientChatReceived(RakNet::Packet* p);
-	void OnPlayerReady(RakNet::Packet* p);
-	void OnPlayerUnready(RakNet::Packet* p);
-	// RequestPlayersFromServer ->
-	void OnPlayerListRequest(RakNet::Packet* p);
-	void OnPlayerJobChosen(RakNet::Packet* p);
-	// RequestPlayerStatsFromServer ->
-	void OnPlayerStatsRequest(RakNet::Packet* p);
-	void OnPlayerActionTaken(RakNet::Packet* p);
-
-	// -> OnTakeTurn
-	void NextTurn();
-	// -> OnPlayersHealthUpdated 
-	void ModifyHealth(Player& player, int diff);
+	void OnConnectionClosed(RakNet::Packet* p);
 
 	void GameLoop();
-	void StartGame();
-	void StartMainGame();
-	void GameOver(unsigned long winnerId);
-	Player& GetPlayer(RakNet::RakNetGUID id);
-	Player& GetPlayer(unsigned long id);
-	Player* GetPlayerWithName(const char* name);
-	RakNet::SystemAddress GetAddressFromID(unsigned long id);
+	// How long the packet thread may sleep before GameLoop has work due
+	int GetGameLoopDelay() const;
 	void BroadcastMessage(const char* input);
+	// .allocs
+	void PrintHandlerAllocations() const;
+	// Message latencies and matchmaking waits, every LATENCY_DUMP_INTERVAL_MS if that is set and on .latency
+	void PrintMessageLatencies();
+	// .loglevel <subsystem> <level>
+	void SetLogLevel(const char* input);
 
 	bool IsRunning() const;
 
@@ -70,15 +72,17 @@ private:
 	RakNet::RakPeerInterface* rpi;
 	std::mutex networkState_mutex;
 	NetworkState networkState;
-	GameState gameState;
 	unsigned int port;
-	std::mutex totalPlayers_mutex;
 	unsigned short totalConnections;
-	static unsigned int EXPECTED_PLAYERS;
-	std::mutex players_mutex;
-	std::map<unsigned long, Player> players;
-	std::map<unsigned long, RakNet::SystemAddress> playerAddresses;
-	unsigned long currentPlayerTurn;
+	static unsigned int MAX_CONNECTIONS;
+	static int MAX_IDLE_WAIT_MS;
+	static int LATENCY_DUMP_INTERVAL_MS;
+	RakNet::TimeMS nextLatencyDump;
+	PacketPump pump;
+	MatchManager matchManager;
+	SessionRecorder recorder;
+	bool isRecording;
+	bool isReplaying;
 	bool isQuitting;
+	std::atomic<bool> isLatencyRequested;
 };
-
@@ -0,0 +1,248 @@
+#include "sessionrecording.h"
+
+#include <cstring>
+
+unsigned int SessionRecorder::FLUSH_BYTES = 1 << 20;
+
+namespace
+{
+	const char MAGIC[8] = { 'R', 'R', 'P', 'G', 'R', 'E', 'C', '5' };
+	// Longest SystemAddress::ToString with a port
+	const unsigned int ADDRESS_SIZE = 64;
+}
+
+SessionRecorder::SessionRecorder()
+	: file(nullptr), isClosing(false)
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	Close();
+}
+
+bool SessionRecorder::Open(const char* path, uint64_t seed)
+{
+	file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	fwrite(MAGIC, 1, sizeof(MAGIC), file);
+	fwrite(&seed, sizeof(seed), 1, file);
+	active.reserve(FLUSH_BYTES);
+	isClosing = false;
+	writer = std::thread(&SessionRecorder::WriterLoop, this);
+	return true;
+}
+
+void SessionRecorder::Close()
+{
+	if (file == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(pending_mutex);
+		isClosing = true;
+	}
+	pendingReady.notify_one();
+	writer.join();
+
+	fwrite(active.data(), 1, active.size(), file);
+	active.clear();
+	fclose(file);
+	file = nullptr;
+}
+
+void SessionRecorder::RecordPacket(const RakNet::Packet* packet, RakNet::TimeMS now, int ping)
+{
+	if (file == nullptr)
+		return;
+
+	// Layout: kind, time, ping, guid, address length and text, packet length and bytes
+	RecordKind kind = RECORD_PACKET;
+	char address[ADDRESS_SIZE];
+	packet->systemAddress.ToString(true, address, '|');
+	unsigned char addressLength = (unsigned char)strlen(address);
+	Append(&kind, sizeof(kind));
+	Append(&now, sizeof(now));
+	Append(&ping, sizeof(ping));
+	Append(&packet->guid.g, sizeof(packet->guid.g));
+	Append(&addressLength, sizeof(addressLength));
+	Append(address, addressLength);
+	Append(&packet->length, sizeof(packet->length));
+	Append(packet->data, packet->length);
+	Offer();
+}
+
+void SessionRecorder::RecordGameLoop(RakNet::TimeMS now)
+{
+	if (file == nullptr)
+		return;
+
+	RecordKind kind = RECORD_GAME_LOOP;
+	Append(&kind, sizeof(kind));
+	Append(&now, sizeof(now));
+	Offer();
+}
+
+void SessionRecorder::RecordTimer(unsigned int matchID, unsigned char type, unsigned int turn)
+{
+	if (file == nullptr)
+		return;
+
+	RecordKind kind = RECORD_TIMER;
+	Append(&kind, sizeof(kind));
+	Append(&matchID, sizeof(matchID));
+	Append(&type, sizeof(type));
+	Append(&turn, sizeof(turn));
+	Offer();
+}
+
+void SessionRecorder::RecordTeardown(unsigned int matchID)
+{
+	if (file == nullptr)
+		return;
+
+	RecordKind kind = RECORD_TEARDOWN;
+	Append(&kind, sizeof(kind));
+	Append(&matchID, sizeof(matchID));
+	Offer();
+}
+
+void SessionRecorder::RecordRequeue(unsigned int matchID, RakNet::RakNetGUID guid)
+{
+	if (file == nullptr)
+		return;
+
+	RecordKind kind = RECORD_REQUEUE;
+	Append(&kind, sizeof(kind));
+	Append(&matchID, sizeof(matchID));
+	Append(&guid.g, sizeof(guid.g));
+	Offer();
+}
+
+void SessionRecorder::Append(const void* data, size_t length)
+{
+	const char* bytes = (const char*)data;
+	active.insert(active.end(), bytes, bytes + length);
+}
+
+void SessionRecorder::Offer()
+{
+	// Never waits on the writer: if it is still busy the buffer just keeps growing until next time
+	if (active.size() >= FLUSH_BYTES && pending_mutex.try_lock())
+	{
+		bool handedOver = pending.empty();
+		if (handedOver)
+			active.swap(pending);
+		pending_mutex.unlock();
+		if (handedOver)
+			pendingReady.notify_one();
+	}
+}
+
+void SessionRecorder::WriterLoop()
+{
+	std::vector<char> chunk;
+	std::unique_lock<std::mutex> lock(pending_mutex);
+	for (;;)
+	{
+		pendingReady.wait(lock, [this] { return !pending.empty() || isClosing; });
+		if (pending.empty())
+			return;
+
+		chunk.swap(pending);
+		lock.unlock();
+		fwrite(chunk.data(), 1, chunk.size(), file);
+		chunk.clear();
+		lock.lock();
+
+		// Give the capacity back so the packet thread does not have to grow a fresh buffer
+		if (pending.empty())
+			chunk.swap(pending);
+	}
+}
+
+SessionReader::SessionReader()
+	: file(nullptr), seed(0)
+{
+}
+
+SessionReader::~SessionReader()
+{
+	if (file != nullptr)
+		fclose(file);
+}
+
+bool SessionReader::Open(const char* path)
+{
+	file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	char magic[sizeof(MAGIC)];
+	return fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0
+		&& fread(&seed, sizeof(seed), 1, file) == 1;
+}
+
+bool SessionReader::Next(SessionRecord& record)
+{
+	if (fread(&record.kind, sizeof(record.kind), 1, file) != 1)
+		return false;
+
+	switch (record.kind)
+	{
+	case RECORD_PACKET:
+		return NextPacket(record);
+	case RECORD_GAME_LOOP:
+		return fread(&record.time, sizeof(record.time), 1, file) == 1;
+	case RECORD_TIMER:
+		return fread(&record.matchID, sizeof(record.matchID), 1, file) == 1
+			&& fread(&record.type, sizeof(record.type), 1, file) == 1
+			&& fread(&record.turn, sizeof(record.turn), 1, file) == 1;
+	case RECORD_TEARDOWN:
+		return fread(&record.matchID, sizeof(record.matchID), 1, file) == 1;
+	case RECORD_REQUEUE:
+	{
+		uint64_t guid;
+		if (fread(&record.matchID, sizeof(record.matchID), 1, file) != 1 || fread(&guid, sizeof(guid), 1, file) != 1)
+			return false;
+
+		record.guid = RakNet::RakNetGUID(guid);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool SessionReader::NextPacket(SessionRecord& record)
+{
+	uint64_t guid;
+	unsigned char addressLength;
+	char address[ADDRESS_SIZE];
+	if (fread(&record.time, sizeof(record.time), 1, file) != 1
+		|| fread(&record.ping, sizeof(record.ping), 1, file) != 1
+		|| fread(&guid, sizeof(guid), 1, file) != 1
+		|| fread(&addressLength, sizeof(addressLength), 1, file) != 1
+		|| addressLength >= ADDRESS_SIZE
+		|| fread(address, 1, addressLength, file) != addressLength
+		|| fread(&record.length, sizeof(record.length), 1, file) != 1)
+		return false;
+
+	address[addressLength] = '\0';
+	record.guid = RakNet::RakNetGUID(guid);
+	record.systemAddress.FromString(address, '|');
+
+	data.resize(record.length);
+	if (fread(data.data(), 1, record.length, file) != record.length)
+		return false;
+
+	record.data = data.data();
+	return true;
+}
+
+uint64_t SessionReader::GetSeed() const
+{
+	return seed;
+}
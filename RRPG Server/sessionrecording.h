@@ -0,0 +1,105 @@
+#pragma once
+#include "RakNetTime.h"
+#include "RakNetTypes.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What a record in a recording holds. Besides the packets themselves the packet thread writes down
+// what it decided by the clock or by racing the workers, so a replay makes the same decisions at the
+// same points in the packet stream instead of making its own
+enum RecordKind : unsigned char
+{
+	// A packet Receive() returned, with when it was handled and the ping matchmaking measured for it
+	RECORD_PACKET,
+	// The game loop ran matchmaking at this time
+	RECORD_GAME_LOOP,
+	// A timer fired and its command was posted to the match
+	RECORD_TIMER,
+	// A finished match was torn down
+	RECORD_TEARDOWN,
+	// A match handed a player back and matchmaking queued them again
+	RECORD_REQUEUE
+};
+
+// Appends every packet the server's RakPeer hands out, and the packet thread's own decisions, to a
+// file for Server::Replay. The packet thread only copies into memory; a background thread writes to
+// disk. Records are in host byte order, recordings are meant to be replayed on the machine type that
+// made them.
+class SessionRecorder
+{
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	// The match seed goes in the header so a replay rolls the same numbers
+	bool Open(const char* path, uint64_t seed);
+	// Writes out everything recorded so far
+	void Close();
+
+	// In the order Receive() returned them, before they are handled
+	void RecordPacket(const RakNet::Packet* packet, RakNet::TimeMS now, int ping);
+	void RecordGameLoop(RakNet::TimeMS now);
+	void RecordTimer(unsigned int matchID, unsigned char type, unsigned int turn);
+	void RecordTeardown(unsigned int matchID);
+	void RecordRequeue(unsigned int matchID, RakNet::RakNetGUID guid);
+
+	// Buffered bytes after which the packet thread offers them to the writer
+	static unsigned int FLUSH_BYTES;
+
+private:
+	void Append(const void* data, size_t length);
+	// Hands the buffer to the writer once it is big enough
+	void Offer();
+	void WriterLoop();
+
+	FILE* file;
+	std::vector<char> active;
+	// Handed over by the packet thread, empty while the writer is busy with the previous one
+	std::vector<char> pending;
+	std::mutex pending_mutex;
+	std::condition_variable pendingReady;
+	std::thread writer;
+	bool isClosing;
+};
+
+struct SessionRecord
+{
+	RecordKind kind;
+	// RECORD_PACKET and RECORD_GAME_LOOP
+	RakNet::TimeMS time;
+	// RECORD_PACKET
+	int ping;
+	// RECORD_PACKET and RECORD_REQUEUE
+	RakNet::RakNetGUID guid;
+	RakNet::SystemAddress systemAddress;
+	// Points into the reader's buffer, valid until the next call to Next
+	const unsigned char* data;
+	unsigned int length;
+	// RECORD_TIMER, RECORD_TEARDOWN and RECORD_REQUEUE
+	unsigned int matchID;
+	// RECORD_TIMER: MC_TURN_TIMEOUT or MC_CHAT_FLUSH, and the turn it was armed for
+	unsigned char type;
+	unsigned int turn;
+};
+
+class SessionReader
+{
+public:
+	SessionReader();
+	~SessionReader();
+
+	bool Open(const char* path);
+	// False at the end of the recording or if it is cut short
+	bool Next(SessionRecord& record);
+	uint64_t GetSeed() const;
+
+private:
+	bool NextPacket(SessionRecord& record);
+
+	FILE* file;
+	uint64_t seed;
+	std::vector<unsigned char> data;
+};
@@ -0,0 +1,165 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel(RakNet::TimeMS now, unsigned int tickMs)
+	: tickMs(tickMs == 0 ? 1 : tickMs), time(now), currentTick(0), count(0), freeList(NIL)
+{
+	for (uint32_t& bucket : buckets)
+		bucket = NIL;
+}
+
+TimerHandle TimerWheel::Add(unsigned int delayMs, uint64_t payload)
+{
+	uint32_t index;
+	if (freeList != NIL)
+	{
+		index = freeList;
+		freeList = nodes[index].next;
+	}
+	else
+	{
+		index = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+		nodes[index].generation = 1;
+	}
+
+	// Never due on the tick already run, it would wait a whole turn of the wheel
+	uint64_t ticks = delayMs / tickMs + 1;
+	Node& node = nodes[index];
+	node.expires = currentTick + (ticks < MAX_TICKS ? ticks : MAX_TICKS);
+	node.payload = payload;
+	node.isActive = true;
+	Place(index);
+	count++;
+	return ((TimerHandle)node.generation << 32) | index;
+}
+
+bool TimerWheel::Cancel(TimerHandle handle)
+{
+	uint32_t index = (uint32_t)handle;
+	if (handle == NO_TIMER || index >= nodes.size())
+		return false;
+
+	Node& node = nodes[index];
+	if (!node.isActive || node.generation != (uint32_t)(handle >> 32))
+		return false;
+
+	Unlink(index);
+	Free(index);
+	count--;
+	return true;
+}
+
+void TimerWheel::Advance(RakNet::TimeMS now, std::vector<uint64_t>& expired)
+{
+	// Wrap-safe; a clock that steps backwards just waits for time to catch up
+	RakNet::TimeMS elapsed = now - time;
+	if ((int)elapsed < 0)
+		return;
+
+	RakNet::TimeMS ticks = elapsed / tickMs;
+	time += ticks * tickMs;
+	if (count == 0)
+	{
+		currentTick += ticks;
+		return;
+	}
+
+	while (ticks-- > 0)
+		Tick(expired);
+}
+
+size_t TimerWheel::GetCount() const
+{
+	return count;
+}
+
+int TimerWheel::GetDelay(RakNet::TimeMS now) const
+{
+	if (count == 0)
+		return -1;
+
+	int untilTick = (int)(time + tickMs - now);
+	return untilTick > 0 ? untilTick : 0;
+}
+
+void TimerWheel::Tick(std::vector<uint64_t>& expired)
+{
+	currentTick++;
+
+	// Each level pours its next bucket into the finer ones whenever every level below it rolls over
+	for (unsigned int level = 1; level < LEVELS; level++)
+	{
+		if ((currentTick & ((1ull << (level * LEVEL_BITS)) - 1)) != 0)
+			break;
+
+		unsigned int slot = (unsigned int)(currentTick >> (level * LEVEL_BITS)) & (SLOTS - 1);
+		for (uint32_t index = Detach(level * SLOTS + slot); index != NIL;)
+		{
+			uint32_t next = nodes[index].next;
+			Place(index);
+			index = next;
+		}
+	}
+
+	for (uint32_t index = Detach((unsigned int)currentTick & (SLOTS - 1)); index != NIL;)
+	{
+		uint32_t next = nodes[index].next;
+		expired.push_back(nodes[index].payload);
+		Free(index);
+		count--;
+		index = next;
+	}
+}
+
+void TimerWheel::Place(uint32_t index)
+{
+	const Node& node = nodes[index];
+	uint64_t delta = node.expires - currentTick;
+	unsigned int level = 0;
+	while (level < LEVELS - 1 && delta >= (1ull << ((level + 1) * LEVEL_BITS)))
+		level++;
+
+	unsigned int slot = (unsigned int)(node.expires >> (level * LEVEL_BITS)) & (SLOTS - 1);
+	Link(index, level * SLOTS + slot);
+}
+
+void TimerWheel::Link(uint32_t index, unsigned int bucket)
+{
+	Node& node = nodes[index];
+	node.bucket = (uint16_t)bucket;
+	node.prev = NIL;
+	node.next = buckets[bucket];
+	if (node.next != NIL)
+		nodes[node.next].prev = index;
+	buckets[bucket] = index;
+}
+
+void TimerWheel::Unlink(uint32_t index)
+{
+	Node& node = nodes[index];
+	if (node.prev != NIL)
+		nodes[node.prev].next = node.next;
+	else
+		buckets[node.bucket] = node.next;
+
+	if (node.next != NIL)
+		nodes[node.next].prev = node.prev;
+}
+
+uint32_t TimerWheel::Detach(unsigned int bucket)
+{
+	uint32_t first = buckets[bucket];
+	buckets[bucket] = NIL;
+	return first;
+}
+
+void TimerWheel::Free(uint32_t index)
+{
+	Node& node = nodes[index];
+	node.isActive = false;
+	node.generation++;
+	if (node.generation == 0)
+		node.generation = 1;
+	node.next = freeList;
+	freeList = index;
+}
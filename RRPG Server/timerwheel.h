@@ -0,0 +1,68 @@
+#pragma once
+#include "RakNetTime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t TimerHandle;
+const TimerHandle NO_TIMER = 0;
+
+// Hierarchical timing wheel after Varghese and Lauck. Four levels of 64 buckets, each level's bucket
+// spanning a whole turn of the level below; a timer sits in the coarsest bucket that can hold it and
+// is poured into finer ones as its deadline comes closer. Adding, cancelling and each tick are O(1)
+// however many timers are pending, and a timer is moved at most three times before it fires.
+// Timers fire within a tick of their deadline. Not thread-safe.
+class TimerWheel
+{
+public:
+	TimerWheel(RakNet::TimeMS now, unsigned int tickMs);
+
+	// Due delayMs after the last Advance, payload is handed back when it fires
+	TimerHandle Add(unsigned int delayMs, uint64_t payload);
+	// False if the timer already fired or was cancelled
+	bool Cancel(TimerHandle handle);
+	// Runs every tick up to now, appending the payloads of the timers that fired, tick by tick
+	void Advance(RakNet::TimeMS now, std::vector<uint64_t>& expired);
+
+	size_t GetCount() const;
+	// Milliseconds until the next tick that could fire something, -1 if nothing is pending
+	int GetDelay(RakNet::TimeMS now) const;
+
+private:
+	static const unsigned int LEVEL_BITS = 6;
+	static const unsigned int SLOTS = 1 << LEVEL_BITS;
+	static const unsigned int LEVELS = 4;
+	static const uint32_t NIL = 0xFFFFFFFF;
+	// Farther deadlines are pulled in to the last tick the wheel can hold, about 19 days at 100ms
+	static const uint64_t MAX_TICKS = (1ull << (LEVEL_BITS * LEVELS)) - 1;
+
+	struct Node
+	{
+		uint64_t expires;
+		uint64_t payload;
+		uint32_t next;
+		uint32_t prev;
+		// Bumped every time the node is freed so stale handles are refused
+		uint32_t generation;
+		uint16_t bucket;
+		bool isActive;
+	};
+
+	void Tick(std::vector<uint64_t>& expired);
+	void Place(uint32_t index);
+	void Link(uint32_t index, unsigned int bucket);
+	void Unlink(uint32_t index);
+	// Empties a bucket and returns its first node, the rest still hang off next
+	uint32_t Detach(unsigned int bucket);
+	void Free(uint32_t index);
+
+	unsigned int tickMs;
+	// Wall time of the last tick that ran
+	RakNet::TimeMS time;
+	uint64_t currentTick;
+	size_t count;
+	uint32_t buckets[LEVELS * SLOTS];
+	std::vector<Node> nodes;
+	uint32_t freeList;
+};
@@ -0,0 +1,127 @@
+#include "workerpool.h"
+#include "matchmanager.h"
+#include "log.h"
+
+WorkerPool::WorkerPool(MatchManager& matchManager)
+	: matchManager(matchManager), runnableMatches(0), isRunning(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+void WorkerPool::Start(unsigned int workerCount)
+{
+	if (workerCount == 0)
+		workerCount = 1;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.emplace_back(new Worker());
+
+	isRunning = true;
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers[i]->thread = std::thread(&WorkerPool::WorkerLoop, this, i);
+
+	Log::Write(LOG_SERVER, LOG_INFO, "Started %u match workers", workerCount);
+}
+
+void WorkerPool::Stop()
+{
+	if (!isRunning)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(idle_mutex);
+		isRunning = false;
+	}
+	idle.notify_all();
+
+	for (auto& worker : workers)
+		worker->thread.join();
+
+	workers.clear();
+}
+
+unsigned int WorkerPool::GetWorkerCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+void WorkerPool::Schedule(Match* match)
+{
+	Push(match->GetID() % workers.size(), match);
+}
+
+void WorkerPool::WorkerLoop(unsigned int index)
+{
+	while (isRunning)
+	{
+		Match* match = PopLocal(index);
+		if (match == nullptr)
+			match = Steal(index);
+
+		if (match == nullptr)
+		{
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			idle.wait(lock, [this] { return runnableMatches > 0 || !isRunning; });
+			continue;
+		}
+
+		// The match may be destroyed as soon as Run() reports it idle, so grab what we need first
+		unsigned int id = match->GetID();
+		bool finished = false;
+		if (match->Run(finished))
+			Schedule(match);
+
+		if (finished)
+			matchManager.OnMatchFinished(id);
+	}
+}
+
+Match* WorkerPool::PopLocal(unsigned int index)
+{
+	Worker& worker = *workers[index];
+	std::lock_guard<std::mutex> guard(worker.runQueue_mutex);
+	if (worker.runQueue.empty())
+		return nullptr;
+
+	Match* match = worker.runQueue.front();
+	worker.runQueue.pop_front();
+	runnableMatches--;
+	return match;
+}
+
+Match* WorkerPool::Steal(unsigned int thief)
+{
+	for (size_t i = 1; i < workers.size(); i++)
+	{
+		Worker& victim = *workers[(thief + i) % workers.size()];
+		std::lock_guard<std::mutex> guard(victim.runQueue_mutex);
+		if (victim.runQueue.empty())
+			continue;
+
+		Match* match = victim.runQueue.back();
+		victim.runQueue.pop_back();
+		runnableMatches--;
+		return match;
+	}
+
+	return nullptr;
+}
+
+void WorkerPool::Push(unsigned int index, Match* match)
+{
+	Worker& worker = *workers[index];
+	{
+		std::lock_guard<std::mutex> guard(worker.runQueue_mutex);
+		worker.runQueue.push_back(match);
+		runnableMatches++;
+	}
+
+	// Sleeping workers check runnableMatches under idle_mutex, taking it here means none can miss the wake up
+	idle_mutex.lock();
+	idle_mutex.unlock();
+	idle.notify_one();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Match;
+class MatchManager;
+
+// One worker per core, each with its own run queue of matches that have packets waiting.
+// A match only ever sits in one run queue at a time, so its packets are handled in order
+// by a single thread; idle workers steal runnable matches from the back of busy queues.
+class WorkerPool
+{
+public:
+	WorkerPool(MatchManager& matchManager);
+	~WorkerPool();
+
+	void Start(unsigned int workerCount);
+	void Stop();
+	unsigned int GetWorkerCount() const;
+
+	// Queues the match on its home worker, call only when it goes from idle to runnable
+	void Schedule(Match* match);
+
+private:
+	struct Worker
+	{
+		std::mutex runQueue_mutex;
+		std::deque<Match*> runQueue;
+		std::thread thread;
+	};
+
+	void WorkerLoop(unsigned int index);
+	Match* PopLocal(unsigned int index);
+	Match* Steal(unsigned int thief);
+	void Push(unsigned int index, Match* match);
+
+private:
+	MatchManager& matchManager;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::mutex idle_mutex;
+	std::condition_variable idle;
+	std::atomic<unsigned int> runnableMatches;
+	std::atomic<bool> isRunning;
+};
@@ -1,6 +1,10 @@
 #pragma once
 #include "RRPG_Player.h"
+#include "RRPG_PlayerIndex.h"
 #include "RRPG_MessageIdentifiers.h"
+#include "RRPG_Messages.h"
+#include "RRPG_PacketPump.h"
+#include "RRPG_SendPolicy.h"
 
 #include "RakPeerInterface.h"
 #include <string>
@@ -40,30 +44,64 @@ private:
 
 	void PacketHandler();
 	bool IsLowLevelPacketHandled(RakNet::Packet* p);
+	void HandlePacket(RakNet::Packet* p);
+
+	typedef void (RRPG::*MessageHandler)(RakNet::Packet* p);
+	static DispatchTable<MessageHandler> MakeMessageHandlers();
 
 	void OnConnectionAccepted(RakNet::Packet* p);
+	// Mid-game the client reconnects and resumes its seat with the token from S_INTRO_ACCEPTED
+	void OnConnectionLost(RakNet::Packet* p);
+	void Reconnect();
+	// A failed reconnect is retried after a delay that doubles each time. After MAX_RESUME_ATTEMPTS the
+	// seat is given up on and the client joins a new match, after MAX_RECONNECT_ATTEMPTS it stops
+	void ScheduleReconnect();
+	// Makes the attempt ScheduleReconnect set up once its delay is over
+	void UpdateReconnect();
+	void SendIntro(const RakNet::SystemAddress& address);
+	void OnIntroAccepted(RakNet::Packet* p);
+	// Replaces the roster, stats and turn with the server's, in place of what was missed while away
+	void OnMatchSnapshot(RakNet::Packet* p);
+	void OnResumeRejected(RakNet::Packet* p);
+	void OnBatchReceived(RakNet::Packet* p);
 	void OnPlayersListReceived(RakNet::Packet* p);
 	void OnPlayersStatsReceived(RakNet::Packet* p);
+	void OnNotModified(RakNet::Packet* p);
 	void OnGameStart(RakNet::Packet* p);
-	void OnMainGameStart(RakNet::Packet* p);
 	void OnGameOver(RakNet::Packet* p);
 	void OnTakeTurn(RakNet::Packet* p);
 	void OnGameStateUpdate(RakNet::Packet* p);
-	void OnPlayersHealthUpdated(RakNet::Packet* p);
+	// Stats are mirrored from the server, .stats is answered from the mirror
+	void OnPlayerStatsDelta(RakNet::Packet* p);
+	bool ReadPlayerStats(RakNet::BitStream* bs, bool announce);
+	void OnChatReceived(RakNet::Packet* p);
+	void OnPlayerJobChosen(RakNet::Packet* p);
+	void OnPlayerActionTaken(RakNet::Packet* p);
+	void OnTurnChanged(RakNet::Packet* p);
+	// The server moved on, possibly from our own turn
+	void OnTurnTimedOut(RakNet::Packet* p);
 
 	void Ready();
 	void Unready();
 	void RequestPlayersFromServer();
 	void RequestPlayerStatsFromServer();
 	void PrintLocalPlayerStats();
+	void PrintPlayerList();
 
 	bool IsRunning() const;
 	void GameLoop();
 
 private:
 	static RRPG* instance;
+	static int MAX_IDLE_WAIT_MS;
+	static unsigned int RECONNECT_DELAY_MS;
+	static unsigned int MAX_RECONNECT_DELAY_MS;
+	static unsigned int MAX_RESUME_ATTEMPTS;
+	static unsigned int MAX_RECONNECT_ATTEMPTS;
+	static const DispatchTable<MessageHandler> messageHandlers;
 
 	RakNet::RakPeerInterface* rpi;
+	PacketPump pump;
 	std::mutex networkState_mutex;
 	NetworkState networkState;
 	GameState gameState;
@@ -74,6 +112,19 @@ private:
 	std::mutex player_mutex;
 	Player player;
 	std::vector<Player> players;
+	PlayerIndex playerIndex;
+	PlayerSlot mySlot;
+	unsigned int statsVersion;
+	// Last player list the server sent, shown again when it answers not modified
+	std::vector<Player> lobbyPlayers;
+	unsigned int listVersion;
 
 	bool myTurn;
+	uint64_t resumeToken;
+	bool isResuming;
+	// From a lost connection until the client is connected again or gives up
+	bool isReconnecting;
+	bool isReconnectScheduled;
+	unsigned int reconnectAttempts;
+	RakNet::TimeMS nextReconnect;
 };
\ No newline at end of file